@@ -0,0 +1,237 @@
+#include "CatalogueImporter.h"
+#include "DatabaseManager.h"
+#include "Isbn.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QUuid>
+#include <QDate>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonParseError>
+
+CatalogueImporter::CatalogueImporter(int rowsPerInsert, int rowsPerTransaction)
+    : rowsPerInsert(qBound(1, rowsPerInsert, 999 / DatabaseManager::itemColumns().size())),
+      rowsPerTransaction(qMax(1, rowsPerTransaction)),
+      currentProgress{0, 0, 0, 0, 0.0}
+{
+}
+
+void CatalogueImporter::setProgressCallback(const std::function<void(const ImportProgress&)>& callback) {
+    progressCallback = callback;
+}
+
+ImportProgress CatalogueImporter::progress() const {
+    return currentProgress;
+}
+
+QString CatalogueImporter::lastError() const {
+    return errorText;
+}
+
+// Imports every record of the file. With resume set, an import of the same file that was interrupted continues
+// from its last committed transaction; a file that was already imported completely is not imported again
+bool CatalogueImporter::importFile(const QString& path, Format format, bool resume) {
+    DatabaseManager& db = DatabaseManager::instance();
+    errorText.clear();
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        errorText = file.errorString();
+        return false;
+    }
+    const QString source = QFileInfo(path).absoluteFilePath();
+    currentProgress = {0, 0, 0, file.size(), 0.0};
+
+    QStringList header;
+    if (format == Format::Csv && !parseCsvRecord(file.readLine().trimmed(), header)) {
+        errorText = "Missing or malformed CSV header";
+        return false;
+    }
+    qint64 resumeOffset = 0;
+    qint64 resumeRecords = 0;
+    if (resume && db.loadImportCheckpoint(source, resumeOffset, resumeRecords) && resumeOffset > file.pos()) {
+        file.seek(resumeOffset);
+        currentProgress.recordsImported = resumeRecords;
+    }
+    currentProgress.bytesRead = file.pos();
+
+    if (!db.beginBulkLoad()) {
+        errorText = "Could not start a bulk load";
+        return false;
+    }
+    timer.start();
+    QVector<QVariantList> block;
+    block.reserve(rowsPerInsert);
+    int rowsInTransaction = 0;
+    bool ok = db.beginUnitOfWork();
+    while (ok && !file.atEnd()) {
+        QByteArray record = file.readLine();
+        if (format == Format::Csv) {
+            // A quoted field may contain line breaks; keep reading until the quotes balance
+            while (record.count('"') % 2 != 0 && !file.atEnd()) {
+                record += file.readLine();
+            }
+        }
+        record = record.trimmed();
+        if (record.isEmpty()) continue;
+
+        QHash<QString, QVariant> fields;
+        if (format == Format::Csv) {
+            QStringList values;
+            if (parseCsvRecord(record, values)) {
+                for (int i = 0; i < header.size() && i < values.size(); ++i) {
+                    fields.insert(header[i], values[i]);
+                }
+            }
+        } else {
+            QJsonParseError parseError;
+            QJsonDocument doc = QJsonDocument::fromJson(record, &parseError);
+            if (parseError.error == QJsonParseError::NoError && doc.isObject()) {
+                const QJsonObject object = doc.object();
+                for (const QString& key : object.keys()) {
+                    fields.insert(key, object.value(key).toVariant());
+                }
+            }
+        }
+
+        QVariantList row;
+        if (!rowFromFields(fields, row)) {
+            ++currentProgress.recordsSkipped;
+            continue;
+        }
+        block.append(row);
+        ++currentProgress.recordsImported;
+        if (block.size() == rowsPerInsert) {
+            ok = db.insertItemRows(block);
+            block.clear();
+        }
+        if (ok && ++rowsInTransaction >= rowsPerTransaction) {
+            ok = commitTransaction(block, source, file.pos()) && db.beginUnitOfWork();
+            rowsInTransaction = 0;
+        }
+    }
+    ok = ok && commitTransaction(block, source, file.pos());
+    if (!ok) {
+        db.rollbackUnitOfWork();
+        errorText = "Import failed; it can be resumed from the last committed transaction";
+    }
+    // The indexes are rebuilt even after a failure so the catalogue stays queryable
+    if (!db.endBulkLoad() && ok) {
+        errorText = "Could not rebuild the Items indexes";
+        ok = false;
+    }
+    return ok;
+}
+
+// Writes the rows still buffered, records the resume point and commits, then reports progress
+bool CatalogueImporter::commitTransaction(QVector<QVariantList>& block, const QString& source, qint64 byteOffset) {
+    DatabaseManager& db = DatabaseManager::instance();
+    bool ok = db.insertItemRows(block);
+    block.clear();
+    ok = ok && db.saveImportCheckpoint(source, byteOffset, currentProgress.recordsImported);
+    if (!ok) return false;
+    if (!db.commitUnitOfWork()) return false;
+    currentProgress.bytesRead = byteOffset;
+    const qint64 elapsedMs = timer.elapsed();
+    currentProgress.recordsPerSecond = elapsedMs > 0 ? currentProgress.recordsImported * 1000.0 / elapsedMs : 0.0;
+    if (progressCallback) progressCallback(currentProgress);
+    return true;
+}
+
+// Validates one record and lays it out in DatabaseManager::itemColumns() order. Returns false for records that
+// cannot become a catalogue item
+bool CatalogueImporter::rowFromFields(const QHash<QString, QVariant>& fields, QVariantList& row) const {
+    static const QStringList itemTypes = {"Fiction", "Non-Fiction", "Magazine", "Movie", "Video Game"};
+    static const QStringList conditions = {"New", "Standard", "Worn"};
+    static const QStringList statuses = {"Available", "CheckedOut", "OnHold"};
+
+    QHash<QString, QVariant> values;
+    const QString itemType = fields.value("itemType").toString().trimmed();
+    const QString title = fields.value("title").toString().trimmed();
+    const QString creator = fields.value("creator").toString().trimmed();
+    bool yearOk = false;
+    const int year = fields.value("publicationYear").toInt(&yearOk);
+    if (!itemTypes.contains(itemType) || title.isEmpty() || creator.isEmpty() || !yearOk) return false;
+
+    QString condition = fields.value("condition").toString().trimmed();
+    if (condition.isEmpty()) condition = "Standard";
+    QString status = fields.value("status").toString().trimmed();
+    if (status.isEmpty()) status = "Available";
+    const int conditionCode = conditions.indexOf(condition);
+    const int statusCode = statuses.indexOf(status);
+    if (conditionCode < 0 || statusCode < 0) return false;
+
+    QUuid itemId(fields.value("itemId").toString());
+    if (itemId.isNull()) itemId = QUuid::createUuid();
+
+    // Stored in the compact encodings of schema v3: blob id, enum codes and Julian day dates. itemTypes is in
+    // ItemType order
+    values.insert("itemId", itemId.toRfc4122());
+    values.insert("itemType", itemTypes.indexOf(itemType));
+    values.insert("title", title);
+    values.insert("creator", creator);
+    values.insert("publicationYear", year);
+    values.insert("format", fields.value("format").toString().trimmed());
+    values.insert("condition", conditionCode);
+    values.insert("status", statusCode);
+
+    // Optional columns stay NULL when absent
+    const QStringList optionalText = {"isbn", "deweyClass", "genre", "platform"};
+    for (const QString& column : optionalText) {
+        const QString text = fields.value(column).toString().trimmed();
+        if (!text.isEmpty()) values.insert(column, text);
+    }
+    const QString isbnNormalized = Isbn::normalize(values.value("isbn").toString());
+    if (!isbnNormalized.isEmpty()) values.insert("isbnNormalized", isbnNormalized);
+    const QStringList optionalNumbers = {"issueNumber", "rating"};
+    for (const QString& column : optionalNumbers) {
+        bool numberOk = false;
+        const int number = fields.value(column).toInt(&numberOk);
+        if (numberOk) values.insert(column, number);
+    }
+    const QStringList optionalDates = {"dueDate", "publicationDate"};
+    for (const QString& column : optionalDates) {
+        const QString text = fields.value(column).toString().trimmed();
+        if (text.isEmpty()) continue;
+        const QDate date = QDate::fromString(text, Qt::ISODate);
+        if (!date.isValid()) return false;
+        values.insert(column, date.toJulianDay());
+    }
+
+    row.clear();
+    for (const QString& column : DatabaseManager::itemColumns()) {
+        row.append(values.value(column));
+    }
+    return true;
+}
+
+// Splits one RFC 4180 CSV record into fields, handling quoted fields with embedded commas, quotes and line breaks
+bool CatalogueImporter::parseCsvRecord(const QByteArray& record, QStringList& fields) {
+    fields.clear();
+    if (record.isEmpty()) return false;
+    QByteArray field;
+    bool inQuotes = false;
+    for (int i = 0; i < record.size(); ++i) {
+        const char c = record.at(i);
+        if (inQuotes) {
+            if (c == '"') {
+                if (i + 1 < record.size() && record.at(i + 1) == '"') {
+                    field.append('"');
+                    ++i;
+                } else {
+                    inQuotes = false;
+                }
+            } else {
+                field.append(c);
+            }
+        } else if (c == '"') {
+            inQuotes = true;
+        } else if (c == ',') {
+            fields.append(QString::fromUtf8(field));
+            field.clear();
+        } else {
+            field.append(c);
+        }
+    }
+    fields.append(QString::fromUtf8(field));
+    return !inQuotes;
+}
@@ -0,0 +1,55 @@
+#ifndef CATALOGUEIMPORTER_H
+#define CATALOGUEIMPORTER_H
+
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QVariant>
+#include <QVector>
+#include <QElapsedTimer>
+#include <functional>
+
+struct ImportProgress {
+    qint64 recordsImported;
+    qint64 recordsSkipped;
+    qint64 bytesRead;
+    qint64 totalBytes;
+    double recordsPerSecond;
+};
+
+// Streams catalogue records from a CSV or JSON Lines file into the Items table. Only one block of rows is held in
+// memory at a time; blocks go in as multi-row INSERTs inside large transactions, and each commit also records the
+// file offset reached so an interrupted import can resume where it stopped.
+//
+// CSV files start with a header row naming Items columns (itemType, title, creator, publicationYear, format, ...);
+// JSON Lines files hold one object per line with the same keys. itemType is one of Fiction, Non-Fiction, Magazine,
+// Movie or Video Game; a missing itemId is generated.
+class CatalogueImporter {
+public:
+    enum class Format {
+        Csv,
+        JsonLines
+    };
+
+    explicit CatalogueImporter(int rowsPerInsert = 50, int rowsPerTransaction = 50000);
+
+    void setProgressCallback(const std::function<void(const ImportProgress&)>& callback);
+    bool importFile(const QString& path, Format format, bool resume = true);
+
+    ImportProgress progress() const;
+    QString lastError() const;
+
+private:
+    bool commitTransaction(QVector<QVariantList>& block, const QString& source, qint64 byteOffset);
+    bool rowFromFields(const QHash<QString, QVariant>& fields, QVariantList& row) const;
+    static bool parseCsvRecord(const QByteArray& record, QStringList& fields);
+
+    int rowsPerInsert;
+    int rowsPerTransaction;
+    std::function<void(const ImportProgress&)> progressCallback;
+    ImportProgress currentProgress;
+    QElapsedTimer timer;
+    QString errorText;
+};
+
+#endif // CATALOGUEIMPORTER_H
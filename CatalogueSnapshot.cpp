@@ -0,0 +1,183 @@
+#include "CatalogueSnapshot.h"
+#include <QThread>
+
+CatalogueSnapshot::CatalogueSnapshot(quint64 version, const QVector<std::shared_ptr<const Chunk>>& chunks,
+                                     int itemCount)
+    : snapshotVersion(version), chunks(chunks), itemCount(itemCount)
+{
+}
+
+quint64 CatalogueSnapshot::version() const {
+    return snapshotVersion;
+}
+
+int CatalogueSnapshot::size() const {
+    return itemCount;
+}
+
+const Item* CatalogueSnapshot::at(int index) const {
+    if (index < 0 || index >= itemCount) return nullptr;
+    return chunks[index / ChunkSize]->at(index % ChunkSize).get();
+}
+
+// Claims a reader slot stamped with the current epoch, then pins the snapshot published at that point.
+// The slot is stamped before the snapshot pointer is read, so any snapshot this reader can see was retired no
+// earlier than its epoch and will not be freed until the slot is released
+SnapshotPublisher::Reader::Reader(SnapshotPublisher& publisher)
+    : publisher(publisher), slot(-1), pinned(nullptr)
+{
+    forever {
+        for (int i = 0; i < MaxReaders; ++i) {
+            quint64 idle = 0;
+            const quint64 epoch = publisher.globalEpoch.load();
+            if (publisher.readerEpochs[i].compare_exchange_strong(idle, epoch)) {
+                slot = i;
+                pinned = publisher.current.load();
+                return;
+            }
+        }
+        QThread::yieldCurrentThread();
+    }
+}
+
+SnapshotPublisher::Reader::~Reader() {
+    publisher.readerEpochs[slot].store(0);
+}
+
+// Never null; an empty catalogue is published as an empty snapshot
+const CatalogueSnapshot* SnapshotPublisher::Reader::snapshot() const {
+    return pinned;
+}
+
+SnapshotPublisher::SnapshotPublisher()
+    : current(nullptr), globalEpoch(1), nextVersion(1)
+{
+    for (std::atomic<quint64>& epoch : readerEpochs) {
+        epoch.store(0);
+    }
+    publish(QVector<std::shared_ptr<const Chunk>>(), 0);
+}
+
+// Readers must all have finished before the publisher is destroyed
+SnapshotPublisher::~SnapshotPublisher() {
+    for (const Retired& entry : retired) {
+        delete entry.snapshot;
+    }
+    delete current.load();
+}
+
+// Publishes a snapshot of items, cloning each one
+void SnapshotPublisher::reset(const QVector<Item*>& items) {
+    QVector<std::shared_ptr<const Chunk>> chunks;
+    chunks.reserve((items.size() + CatalogueSnapshot::ChunkSize - 1) / CatalogueSnapshot::ChunkSize);
+    positions.clear();
+    positions.reserve(items.size());
+    Chunk chunk;
+    for (int i = 0; i < items.size(); ++i) {
+        chunk.append(CatalogueSnapshot::ItemRef(items[i]->clone()));
+        positions.insert(items[i]->itemId, i);
+        if (chunk.size() == CatalogueSnapshot::ChunkSize) {
+            chunks.append(std::make_shared<const Chunk>(chunk));
+            chunk.clear();
+        }
+    }
+    if (!chunk.isEmpty()) chunks.append(std::make_shared<const Chunk>(chunk));
+    publish(chunks, items.size());
+}
+
+// Publishes a version with a fresh clone of item, copying only the chunk that holds it
+void SnapshotPublisher::update(const Item* item) {
+    auto position = positions.constFind(item->itemId);
+    if (position == positions.constEnd()) return;
+    const CatalogueSnapshot* snapshot = current.load();
+    QVector<std::shared_ptr<const Chunk>> chunks = snapshot->chunks;
+    const int chunkIndex = position.value() / CatalogueSnapshot::ChunkSize;
+    Chunk chunk = *chunks[chunkIndex];
+    chunk[position.value() % CatalogueSnapshot::ChunkSize] = CatalogueSnapshot::ItemRef(item->clone());
+    chunks[chunkIndex] = std::make_shared<const Chunk>(chunk);
+    publish(chunks, snapshot->itemCount);
+}
+
+void SnapshotPublisher::append(const Item* item) {
+    const CatalogueSnapshot* snapshot = current.load();
+    QVector<std::shared_ptr<const Chunk>> chunks = snapshot->chunks;
+    const int index = snapshot->itemCount;
+    Chunk chunk;
+    if (index % CatalogueSnapshot::ChunkSize != 0) {
+        chunk = *chunks.last();
+        chunks.removeLast();
+    }
+    chunk.append(CatalogueSnapshot::ItemRef(item->clone()));
+    chunks.append(std::make_shared<const Chunk>(chunk));
+    positions.insert(item->itemId, index);
+    publish(chunks, index + 1);
+}
+
+// Publishes a version without the item. The last item moves into its place, so at most the two chunks holding
+// them are copied and only the moved item's position changes; the items themselves are shared, not cloned
+void SnapshotPublisher::remove(const QUuid& itemId) {
+    auto position = positions.find(itemId);
+    if (position == positions.end()) return;
+    const int removed = position.value();
+    positions.erase(position);
+    const CatalogueSnapshot* snapshot = current.load();
+    QVector<std::shared_ptr<const Chunk>> chunks = snapshot->chunks;
+    const int last = snapshot->itemCount - 1;
+    const int lastChunkIndex = last / CatalogueSnapshot::ChunkSize;
+    Chunk lastChunk = *chunks[lastChunkIndex];
+    const CatalogueSnapshot::ItemRef moved = lastChunk.takeLast();
+    if (removed != last) {
+        const int chunkIndex = removed / CatalogueSnapshot::ChunkSize;
+        if (chunkIndex == lastChunkIndex) {
+            lastChunk[removed % CatalogueSnapshot::ChunkSize] = moved;
+        } else {
+            Chunk chunk = *chunks[chunkIndex];
+            chunk[removed % CatalogueSnapshot::ChunkSize] = moved;
+            chunks[chunkIndex] = std::make_shared<const Chunk>(chunk);
+        }
+        positions.insert(moved->itemId, removed);
+    }
+    if (lastChunk.isEmpty()) {
+        chunks.removeLast();
+    } else {
+        chunks[lastChunkIndex] = std::make_shared<const Chunk>(lastChunk);
+    }
+    publish(chunks, last);
+}
+
+void SnapshotPublisher::clear() {
+    positions.clear();
+    publish(QVector<std::shared_ptr<const Chunk>>(), 0);
+}
+
+// Frees retired snapshots that no active reader can still hold
+void SnapshotPublisher::reclaim() {
+    quint64 oldestActive = globalEpoch.load();
+    for (const std::atomic<quint64>& epoch : readerEpochs) {
+        const quint64 value = epoch.load();
+        if (value != 0 && value < oldestActive) oldestActive = value;
+    }
+    for (int i = retired.size() - 1; i >= 0; --i) {
+        if (retired[i].epoch < oldestActive) {
+            delete retired[i].snapshot;
+            retired.remove(i);
+        }
+    }
+}
+
+quint64 SnapshotPublisher::currentVersion() const {
+    return current.load()->version();
+}
+
+int SnapshotPublisher::retiredCount() const {
+    return retired.size();
+}
+
+// Swaps in the new snapshot, then advances the epoch. A reader stamped with the old epoch may still be about to
+// load the old pointer, so the old snapshot is retired with that epoch
+void SnapshotPublisher::publish(const QVector<std::shared_ptr<const Chunk>>& chunks, int itemCount) {
+    const CatalogueSnapshot* previous = current.exchange(new CatalogueSnapshot(nextVersion++, chunks, itemCount));
+    const quint64 epoch = globalEpoch.fetch_add(1);
+    if (previous) retired.append(Retired{previous, epoch});
+    reclaim();
+}
@@ -0,0 +1,107 @@
+#ifndef CATALOGUESNAPSHOT_H
+#define CATALOGUESNAPSHOT_H
+
+#include "Item.h"
+#include <QHash>
+#include <QUuid>
+#include <QVector>
+#include <atomic>
+#include <memory>
+
+// An immutable, versioned view of the catalogue. Items are private clones that are never modified after
+// publication, stored in fixed-size chunks so that a new version can share every chunk it does not change.
+// Safe to read from any thread while held through a SnapshotPublisher::Reader
+class CatalogueSnapshot {
+public:
+    typedef std::shared_ptr<const Item> ItemRef;
+
+    quint64 version() const;
+    int size() const;
+    const Item* at(int index) const;
+
+    template<typename Visitor>
+    void forEach(Visitor visit) const {
+        for (const std::shared_ptr<const Chunk>& chunk : chunks) {
+            for (const ItemRef& item : *chunk) {
+                visit(item.get());
+            }
+        }
+    }
+
+private:
+    friend class SnapshotPublisher;
+
+    static const int ChunkSize = 1024;
+    typedef QVector<ItemRef> Chunk;
+
+    CatalogueSnapshot(quint64 version, const QVector<std::shared_ptr<const Chunk>>& chunks, int itemCount);
+
+    quint64 snapshotVersion;
+    QVector<std::shared_ptr<const Chunk>> chunks;
+    int itemCount;
+};
+
+// Publishes catalogue snapshots from the main thread and hands them to reader threads without locks.
+// Replaced snapshots are retired with the epoch in which they were replaced and freed once every reader that
+// could still see them has finished (epoch-based reclamation)
+class SnapshotPublisher {
+public:
+    // Maximum number of readers holding a snapshot at the same time; further readers wait for a free slot
+    static const int MaxReaders = 64;
+
+    // Pins the current snapshot for the lifetime of the reader. Keep readers short-lived: a held reader stops
+    // every snapshot published after it started from being reclaimed
+    class Reader {
+    public:
+        explicit Reader(SnapshotPublisher& publisher);
+        ~Reader();
+        const CatalogueSnapshot* snapshot() const;
+
+    private:
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+
+        SnapshotPublisher& publisher;
+        int slot;
+        const CatalogueSnapshot* pinned;
+    };
+
+    SnapshotPublisher();
+    ~SnapshotPublisher();
+
+    // Writer side; main thread only
+    void reset(const QVector<Item*>& items);
+    void update(const Item* item);
+    void append(const Item* item);
+    void remove(const QUuid& itemId);
+    void clear();
+    void reclaim();
+
+    quint64 currentVersion() const;
+    int retiredCount() const;
+
+private:
+    SnapshotPublisher(const SnapshotPublisher&) = delete;
+    SnapshotPublisher& operator=(const SnapshotPublisher&) = delete;
+
+    typedef CatalogueSnapshot::Chunk Chunk;
+
+    struct Retired {
+        const CatalogueSnapshot* snapshot;
+        quint64 epoch;
+    };
+
+    void publish(const QVector<std::shared_ptr<const Chunk>>& chunks, int itemCount);
+
+    std::atomic<const CatalogueSnapshot*> current;
+    std::atomic<quint64> globalEpoch;
+    // Epoch each active reader entered in; 0 marks a free slot
+    std::atomic<quint64> readerEpochs[MaxReaders];
+
+    // Writer-only state
+    QVector<Retired> retired;
+    QHash<QUuid, int> positions;
+    quint64 nextVersion;
+};
+
+#endif // CATALOGUESNAPSHOT_H
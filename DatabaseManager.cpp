@@ -4,12 +4,55 @@
 #include "Magazine.h"
 #include "Movie.h"
 #include "VideoGame.h"
+#include "StringPool.h"
+#include "Isbn.h"
 #include <QSqlQuery>
 #include <QSqlError>
 #include <QVariant>
 #include <QFile>
+#include <QHash>
+#include <QSet>
+#include <QDebug>
 
-DatabaseManager::DatabaseManager() { }
+// Schema v3 stores ids as 16-byte RFC 4122 blobs and dates as Julian day numbers
+static QVariant idValue(const QUuid& id) {
+    return id.toRfc4122();
+}
+
+static QVariant dateValue(const QDate& date) {
+    return date.isValid() ? QVariant(date.toJulianDay()) : QVariant();
+}
+
+static QDate dateFromValue(const QVariant& value) {
+    return value.isNull() ? QDate() : QDate::fromJulianDay(value.toLongLong());
+}
+
+static int typeValue(ItemType type) {
+    return static_cast<int>(type);
+}
+
+// Item::typeName() of each stored itemType code, in enum order; used to convert text itemType columns
+static const QStringList& itemTypeNames() {
+    static const QStringList names = {"Fiction", "Non-Fiction", "Magazine", "Movie", "Video Game"};
+    return names;
+}
+
+static ItemCondition conditionFromValue(const QVariant& value) {
+    int code = value.toInt();
+    if (code < static_cast<int>(ItemCondition::New) || code > static_cast<int>(ItemCondition::Worn)) return ItemCondition::Standard;
+    return static_cast<ItemCondition>(code);
+}
+
+static ItemStatus statusFromValue(const QVariant& value) {
+    int code = value.toInt();
+    if (code < static_cast<int>(ItemStatus::Available) || code > static_cast<int>(ItemStatus::OnHold)) return ItemStatus::Available;
+    return static_cast<ItemStatus>(code);
+}
+
+DatabaseManager::DatabaseManager()
+    : statementCacheHits(0), statementCacheMisses(0),
+      unitOfWorkDepth(0), unitOfWorkFailed(false), writer(nullptr), lastUnitTicket(0), bulkLoading(false),
+      changeOrigin(QUuid::createUuid().toRfc4122()) { }
 
 DatabaseManager::~DatabaseManager() { close(); }
 
@@ -20,20 +63,137 @@ DatabaseManager& DatabaseManager::instance() {
 }
 
 // Opens or creates the SQLite database, creates tables if needed, and populates default data for a fresh database
-bool DatabaseManager::initialize(const QString& dbPath) {
+bool DatabaseManager::initialize(const QString& dbPath, PerformanceProfile profile) {
     bool isNewDatabase = !QFile::exists(dbPath);
     db = QSqlDatabase::addDatabase("QSQLITE");
     db.setDatabaseName(dbPath);
     if (!db.open()) return false;
+    if (!applyPerformanceProfile(profile)) return false;
     if (!createTables()) return false;
+    if (!migrateSchema()) return false;
+    // Restores the item indexes and change triggers if a bulk load was interrupted after dropping them
+    if (!createItemIndexes() || !createIsbnIndex() || !createChangeTriggers("Items")) return false;
+    if (!installChangeOriginTrigger()) return false;
     if (isNewDatabase) {
         if (!populateDefaultData()) return false;
     }
+#ifndef QT_NO_DEBUG
+    QStringList fullScans;
+    if (!verifyQueryPlans(&fullScans)) {
+        qWarning() << "Hot queries fall back to full scans:" << fullScans;
+        return false;
+    }
+#endif
     return true;
 }
 
 void DatabaseManager::close() {
-    if (db.isOpen()) db.close();
+    stopWriteBehind();
+    clearStatementCache();
+    if (db.isOpen()) {
+        checkpoint(CheckpointMode::Truncate);
+        db.close();
+    }
+}
+
+// Returns the connection settings for a profile. Every profile runs in WAL mode; they differ in how often
+// SQLite syncs and how much memory it may use. Throughput also disables automatic checkpoints, leaving them
+// to explicit checkpoint() calls.
+QStringList DatabaseManager::profilePragmas(PerformanceProfile profile) {
+    QString synchronous;
+    int cacheSizeKiB = 0;
+    qint64 mmapSize = 0;
+    QString tempStore;
+    int autoCheckpointPages = 1000;
+    switch (profile) {
+        case PerformanceProfile::Durable:
+            synchronous = "FULL";
+            cacheSizeKiB = 8 * 1024;
+            mmapSize = 0;
+            tempStore = "DEFAULT";
+            break;
+        case PerformanceProfile::Balanced:
+            synchronous = "NORMAL";
+            cacheSizeKiB = 32 * 1024;
+            mmapSize = 256LL * 1024 * 1024;
+            tempStore = "MEMORY";
+            break;
+        case PerformanceProfile::Throughput:
+            synchronous = "OFF";
+            cacheSizeKiB = 128 * 1024;
+            mmapSize = 1024LL * 1024 * 1024;
+            tempStore = "MEMORY";
+            autoCheckpointPages = 0;
+            break;
+    }
+    return {
+        QString("PRAGMA synchronous = %1").arg(synchronous),
+        QString("PRAGMA cache_size = -%1").arg(cacheSizeKiB),
+        QString("PRAGMA mmap_size = %1").arg(mmapSize),
+        QString("PRAGMA temp_store = %1").arg(tempStore),
+        QString("PRAGMA wal_autocheckpoint = %1").arg(autoCheckpointPages)
+    };
+}
+
+// Switches the database to WAL and applies the profile's settings to the main connection
+bool DatabaseManager::applyPerformanceProfile(PerformanceProfile profile) {
+    QSqlQuery query;
+    if (!query.exec("PRAGMA journal_mode = WAL") || !query.next() ||
+        query.value(0).toString().compare("wal", Qt::CaseInsensitive) != 0) {
+        qWarning() << "Could not switch the database to WAL mode";
+        return false;
+    }
+    connectionSetup = profilePragmas(profile);
+    for (const QString& pragma : connectionSetup) {
+        if (!query.exec(pragma)) {
+            qWarning() << pragma << "failed:" << query.lastError().text();
+            return false;
+        }
+    }
+    return true;
+}
+
+// Copies committed WAL frames back into the database file. Returns false if the checkpoint could not complete,
+// for example because a reader still holds an older snapshot in Full/Restart/Truncate mode
+bool DatabaseManager::checkpoint(CheckpointMode mode) {
+    QString modeName;
+    switch (mode) {
+        case CheckpointMode::Passive: modeName = "PASSIVE"; break;
+        case CheckpointMode::Full: modeName = "FULL"; break;
+        case CheckpointMode::Restart: modeName = "RESTART"; break;
+        case CheckpointMode::Truncate: modeName = "TRUNCATE"; break;
+    }
+    QSqlQuery query;
+    if (!query.exec(QString("PRAGMA wal_checkpoint(%1)").arg(modeName)) || !query.next()) return false;
+    return query.value(0).toInt() == 0;
+}
+
+// Returns the prepared statement cached under the given id, preparing it on the connection the first time it is requested
+QSqlQuery* DatabaseManager::cachedQuery(const QString& id, const QString& sql) {
+    auto it = statementCache.constFind(id);
+    if (it != statementCache.constEnd()) {
+        ++statementCacheHits;
+        return it.value();
+    }
+    ++statementCacheMisses;
+    QSqlQuery* query = new QSqlQuery(db);
+    if (!query->prepare(sql)) {
+        qWarning() << "Failed to prepare statement" << id << ":" << query->lastError().text();
+        delete query;
+        return nullptr;
+    }
+    statementCache.insert(id, query);
+    return query;
+}
+
+// Releases every cached statement; must run before the connection is closed
+void DatabaseManager::clearStatementCache() {
+    qDeleteAll(statementCache);
+    statementCache.clear();
+}
+
+DatabaseManager::StatementCacheStats DatabaseManager::statementCacheStats() const {
+    return {statementCacheHits, statementCacheMisses};
 }
 
 // Creates all required database tables (Items, Patrons, Librarians, SystemAdmins, Loans, Holds) if they don't exist
@@ -88,6 +248,368 @@ bool DatabaseManager::createTables() {
     return true;
 }
 
+// Reads the schema version stored in the database header
+int DatabaseManager::schemaVersion() {
+    QSqlQuery query("PRAGMA user_version");
+    return query.next() ? query.value(0).toInt() : 0;
+}
+
+// Brings an existing database up to CurrentSchemaVersion, applying each pending migration in its own transaction
+bool DatabaseManager::migrateSchema() {
+    for (int version = schemaVersion() + 1; version <= CurrentSchemaVersion; ++version) {
+        db.transaction();
+        bool ok = false;
+        switch (version) {
+            case 1: ok = migrateToV1(); break;
+            case 2: ok = migrateToV2(); break;
+            case 3: ok = migrateToV3(); break;
+            case 4: ok = migrateToV4(); break;
+            case 5: ok = migrateToV5(); break;
+            case 6: ok = migrateToV6(); break;
+            case 7: ok = migrateToV7(); break;
+            case 8: ok = migrateToV8(); break;
+            case 9: ok = migrateToV9(); break;
+            case 10: ok = migrateToV10(); break;
+        }
+        QSqlQuery query;
+        if (!ok || !query.exec(QString("PRAGMA user_version = %1").arg(version))) {
+            qWarning() << "Schema migration to version" << version << "failed:" << query.lastError().text();
+            db.rollback();
+            return false;
+        }
+        db.commit();
+    }
+    return true;
+}
+
+// Version 1: secondary indexes for the hold queue, loan lookups by item, and item filtering by type and status.
+// Lookups by patronName are already served by the (patronName, itemId) primary keys of Loans and Holds.
+bool DatabaseManager::migrateToV1() {
+    return createCirculationIndexes() && createItemIndexes();
+}
+
+// Version 2: resume points for streaming catalogue imports, keyed by source file
+bool DatabaseManager::migrateToV2() {
+    QSqlQuery query;
+    return query.exec(
+        "CREATE TABLE IF NOT EXISTS ImportCheckpoints ("
+        "source TEXT PRIMARY KEY, "
+        "byteOffset INTEGER NOT NULL, "
+        "records INTEGER NOT NULL"
+        ")");
+}
+
+// Version 3: compact storage. Item ids become 16-byte blobs, item type, condition and status become the integer
+// values of their enums, and dates become Julian day numbers. Items, Loans and Holds are rebuilt row by row
+bool DatabaseManager::migrateToV3() {
+    QSqlQuery query;
+    if (!query.exec(
+        "CREATE TABLE Items_v3 ("
+        "itemId BLOB PRIMARY KEY, "
+        "itemType INTEGER NOT NULL, "
+        "title TEXT NOT NULL, "
+        "creator TEXT NOT NULL, "
+        "publicationYear INTEGER NOT NULL, "
+        "format TEXT NOT NULL, "
+        "condition INTEGER NOT NULL, "
+        "status INTEGER NOT NULL, "
+        "dueDate INTEGER, "
+        "isbn TEXT, "
+        "deweyClass TEXT, "
+        "issueNumber INTEGER, "
+        "publicationDate INTEGER, "
+        "genre TEXT, "
+        "rating INTEGER, "
+        "platform TEXT"
+        ")")) return false;
+    if (!query.exec(
+        "CREATE TABLE Loans_v3 ("
+        "patronName TEXT NOT NULL, "
+        "itemId BLOB NOT NULL, "
+        "dueDate INTEGER NOT NULL, "
+        "PRIMARY KEY (patronName, itemId)"
+        ")")) return false;
+    if (!query.exec(
+        "CREATE TABLE Holds_v3 ("
+        "patronName TEXT NOT NULL, "
+        "itemId BLOB NOT NULL, "
+        "position INTEGER NOT NULL, "
+        "PRIMARY KEY (patronName, itemId)"
+        ")")) return false;
+
+    const QStringList conditions = {"New", "Standard", "Worn"};
+    const QStringList statuses = {"Available", "CheckedOut", "OnHold"};
+    QSqlQuery read;
+    read.setForwardOnly(true);
+    QSqlQuery write;
+    if (!read.exec("SELECT * FROM Items")) return false;
+    if (!write.prepare("INSERT INTO Items_v3 (itemId, itemType, title, creator, publicationYear, format, condition, "
+                       "status, dueDate, isbn, deweyClass, issueNumber, publicationDate, genre, rating, platform) "
+                       "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)")) return false;
+    while (read.next()) {
+        int condition = conditions.indexOf(read.value("condition").toString());
+        int status = statuses.indexOf(read.value("status").toString());
+        write.addBindValue(idValue(QUuid(read.value("itemId").toString())));
+        // Unknown type names become -1, which itemFromRecord() skips as it skipped them before
+        write.addBindValue(itemTypeNames().indexOf(read.value("itemType").toString()));
+        write.addBindValue(read.value("title"));
+        write.addBindValue(read.value("creator"));
+        write.addBindValue(read.value("publicationYear"));
+        write.addBindValue(read.value("format"));
+        write.addBindValue(condition < 0 ? static_cast<int>(ItemCondition::Standard) : condition);
+        write.addBindValue(status < 0 ? static_cast<int>(ItemStatus::Available) : status);
+        write.addBindValue(dateValue(QDate::fromString(read.value("dueDate").toString(), Qt::ISODate)));
+        write.addBindValue(read.value("isbn"));
+        write.addBindValue(read.value("deweyClass"));
+        write.addBindValue(read.value("issueNumber"));
+        write.addBindValue(dateValue(QDate::fromString(read.value("publicationDate").toString(), Qt::ISODate)));
+        write.addBindValue(read.value("genre"));
+        write.addBindValue(read.value("rating"));
+        write.addBindValue(read.value("platform"));
+        if (!write.exec()) return false;
+    }
+    if (!read.exec("SELECT patronName, itemId, dueDate FROM Loans")) return false;
+    if (!write.prepare("INSERT INTO Loans_v3 (patronName, itemId, dueDate) VALUES (?, ?, ?)")) return false;
+    while (read.next()) {
+        write.addBindValue(read.value(0));
+        write.addBindValue(idValue(QUuid(read.value(1).toString())));
+        write.addBindValue(dateValue(QDate::fromString(read.value(2).toString(), Qt::ISODate)));
+        if (!write.exec()) return false;
+    }
+    if (!read.exec("SELECT patronName, itemId, position FROM Holds")) return false;
+    if (!write.prepare("INSERT INTO Holds_v3 (patronName, itemId, position) VALUES (?, ?, ?)")) return false;
+    while (read.next()) {
+        write.addBindValue(read.value(0));
+        write.addBindValue(idValue(QUuid(read.value(1).toString())));
+        write.addBindValue(read.value(2));
+        if (!write.exec()) return false;
+    }
+    read.finish();
+
+    const QStringList tables = {"Items", "Loans", "Holds"};
+    for (const QString& table : tables) {
+        if (!query.exec("DROP TABLE " + table)) return false;
+        if (!query.exec(QString("ALTER TABLE %1_v3 RENAME TO %1").arg(table))) return false;
+    }
+    return createCirculationIndexes() && createItemIndexes();
+}
+
+// Version 4: change log. Triggers on Items, Loans and Holds append the id of every affected item, so other
+// connections can catch up by reading entries past the last sequence number they applied.
+// A NULL itemId marks a change too large to log per item, such as a bulk load
+bool DatabaseManager::migrateToV4() {
+    QSqlQuery query;
+    if (!query.exec(
+        "CREATE TABLE IF NOT EXISTS ChangeLog ("
+        "seq INTEGER PRIMARY KEY AUTOINCREMENT, "
+        "itemId BLOB"
+        ")")) return false;
+    return createChangeTriggers("Items") && createChangeTriggers("Loans") && createChangeTriggers("Holds");
+}
+
+// Version 5: the item type index also covers itemId, so keyset pages of one type are read in index order
+bool DatabaseManager::migrateToV5() {
+    QSqlQuery query;
+    if (!query.exec("DROP INDEX IF EXISTS idx_items_type")) return false;
+    return createItemIndexes();
+}
+
+// Version 6: each item's ISBN in normalized ISBN-13 form, indexed for scanner lookups. NULL when the item has no
+// valid ISBN
+bool DatabaseManager::migrateToV6() {
+    QSqlQuery query;
+    if (!query.exec("ALTER TABLE Items ADD COLUMN isbnNormalized TEXT")) return false;
+    QSqlQuery read;
+    read.setForwardOnly(true);
+    if (!read.exec("SELECT itemId, isbn FROM Items WHERE isbn IS NOT NULL")) return false;
+    if (!query.prepare("UPDATE Items SET isbnNormalized = :isbn WHERE itemId = :itemId")) return false;
+    while (read.next()) {
+        const QString normalized = Isbn::normalize(read.value(1).toString());
+        if (normalized.isEmpty()) continue;
+        query.bindValue(":isbn", normalized);
+        query.bindValue(":itemId", read.value(0));
+        if (!query.exec()) return false;
+    }
+    read.finish();
+    return createIsbnIndex();
+}
+
+// Version 7: fines. accruedThrough is the day through which a loan's overdue fines have been charged, starting at
+// its due date, and idx_loans_due lets the fines pass find overdue loans by range. Loan updates that only move the
+// watermark stay out of the change log
+bool DatabaseManager::migrateToV7() {
+    QSqlQuery query;
+    if (!query.exec("DROP TRIGGER IF EXISTS trg_Loans_update")) return false;
+    if (!query.exec("ALTER TABLE Loans ADD COLUMN accruedThrough INTEGER NOT NULL DEFAULT 0")) return false;
+    if (!query.exec("UPDATE Loans SET accruedThrough = dueDate")) return false;
+    return createChangeTriggers("Loans", "patronName, itemId, dueDate") && createCirculationIndexes();
+}
+
+// Version 8: databases that reached version 3 before it stored item types as integers still have a TEXT itemType
+// column. Rebuild Items with the enum codes; newer databases already have an INTEGER column and are left alone
+bool DatabaseManager::migrateToV8() {
+    QSqlQuery query;
+    if (!query.exec("SELECT type FROM pragma_table_info('Items') WHERE name = 'itemType'")) return false;
+    if (query.next() && query.value(0).toString().compare("INTEGER", Qt::CaseInsensitive) == 0) return true;
+    query.finish();
+    if (!query.exec(
+        "CREATE TABLE Items_v8 ("
+        "itemId BLOB PRIMARY KEY, "
+        "itemType INTEGER NOT NULL, "
+        "title TEXT NOT NULL, "
+        "creator TEXT NOT NULL, "
+        "publicationYear INTEGER NOT NULL, "
+        "format TEXT NOT NULL, "
+        "condition INTEGER NOT NULL, "
+        "status INTEGER NOT NULL, "
+        "dueDate INTEGER, "
+        "isbn TEXT, "
+        "deweyClass TEXT, "
+        "issueNumber INTEGER, "
+        "publicationDate INTEGER, "
+        "genre TEXT, "
+        "rating INTEGER, "
+        "platform TEXT, "
+        "isbnNormalized TEXT"
+        ")")) return false;
+    QStringList cases;
+    for (int i = 0; i < itemTypeNames().size(); ++i) {
+        cases.append(QString("WHEN '%1' THEN %2").arg(itemTypeNames()[i]).arg(i));
+    }
+    QStringList columns = itemColumns();
+    columns.removeOne("itemType");
+    const QString copy = QString("INSERT INTO Items_v8 (itemType, %1) SELECT CASE itemType %2 ELSE -1 END, %1 FROM Items")
+                             .arg(columns.join(", "), cases.join(" "));
+    if (!query.exec(copy)) return false;
+    if (!query.exec("DROP TABLE Items")) return false;
+    if (!query.exec("ALTER TABLE Items_v8 RENAME TO Items")) return false;
+    // Every item row was rewritten; other connections must reload the catalogue
+    if (!query.exec("INSERT INTO ChangeLog (itemId) VALUES (NULL)")) return false;
+    return createItemIndexes() && createIsbnIndex() && createChangeTriggers("Items");
+}
+
+// Version 9: the process that wrote each change log entry, so readers can skip their own writes. NULL for entries
+// written before this version or by connections without the origin trigger
+bool DatabaseManager::migrateToV9() {
+    QSqlQuery query;
+    return query.exec("ALTER TABLE ChangeLog ADD COLUMN origin BLOB");
+}
+
+// Version 10: the fines pass seeks on its accruedThrough watermark, so loans already charged are never read.
+// idx_loans_accrual replaces idx_loans_due, which only bounded the scan by due date
+bool DatabaseManager::migrateToV10() {
+    QSqlQuery query;
+    if (!query.exec("DROP INDEX IF EXISTS idx_loans_due")) return false;
+    return query.exec("CREATE INDEX IF NOT EXISTS idx_loans_accrual ON Loans (accruedThrough, dueDate)");
+}
+
+// Tags every change log entry this connection writes with changeOrigin. The trigger is TEMP, so it only fires for
+// this connection; it is also added to connectionSetup so the write-behind connection tags its entries too
+bool DatabaseManager::installChangeOriginTrigger() {
+    const QString sql = QString(
+        "CREATE TEMP TRIGGER IF NOT EXISTS trg_ChangeLog_origin AFTER INSERT ON main.ChangeLog BEGIN "
+        "UPDATE ChangeLog SET origin = X'%1' WHERE seq = NEW.seq; END").arg(QString::fromLatin1(changeOrigin.toHex()));
+    QSqlQuery query;
+    if (!query.exec(sql)) {
+        qWarning() << "Could not install the change origin trigger:" << query.lastError().text();
+        return false;
+    }
+    connectionSetup.append(sql);
+    return true;
+}
+
+bool DatabaseManager::createIsbnIndex() {
+    QSqlQuery query;
+    return query.exec("CREATE INDEX IF NOT EXISTS idx_items_isbn ON Items (isbnNormalized)");
+}
+
+// Logs inserts, updates and deletes on table. A non-empty updateColumns limits the update trigger to those columns
+bool DatabaseManager::createChangeTriggers(const QString& table, const QString& updateColumns) {
+    QSqlQuery query;
+    const QString updateOf = updateColumns.isEmpty() ? QString() : " OF " + updateColumns;
+    if (!query.exec(QString(
+        "CREATE TRIGGER IF NOT EXISTS trg_%1_insert AFTER INSERT ON %1 BEGIN "
+        "INSERT INTO ChangeLog (itemId) VALUES (NEW.itemId); END").arg(table))) return false;
+    if (!query.exec(QString(
+        "CREATE TRIGGER IF NOT EXISTS trg_%1_update AFTER UPDATE%2 ON %1 BEGIN "
+        "INSERT INTO ChangeLog (itemId) VALUES (NEW.itemId); "
+        "INSERT INTO ChangeLog (itemId) SELECT OLD.itemId WHERE OLD.itemId IS NOT NEW.itemId; END").arg(table, updateOf))) return false;
+    if (!query.exec(QString(
+        "CREATE TRIGGER IF NOT EXISTS trg_%1_delete AFTER DELETE ON %1 BEGIN "
+        "INSERT INTO ChangeLog (itemId) VALUES (OLD.itemId); END").arg(table))) return false;
+    return true;
+}
+
+bool DatabaseManager::dropChangeTriggers(const QString& table) {
+    QSqlQuery query;
+    const QStringList events = {"insert", "update", "delete"};
+    for (const QString& event : events) {
+        if (!query.exec(QString("DROP TRIGGER IF EXISTS trg_%1_%2").arg(table, event))) return false;
+    }
+    return true;
+}
+
+bool DatabaseManager::createCirculationIndexes() {
+    QSqlQuery query;
+    if (!query.exec("CREATE INDEX IF NOT EXISTS idx_holds_item_position ON Holds (itemId, position)")) return false;
+    if (!query.exec("CREATE INDEX IF NOT EXISTS idx_loans_item ON Loans (itemId)")) return false;
+    if (!query.exec("CREATE INDEX IF NOT EXISTS idx_loans_due ON Loans (dueDate)")) return false;
+    return true;
+}
+
+// Secondary indexes on Items. Bulk loads drop them and rebuild them once at the end
+bool DatabaseManager::createItemIndexes() {
+    QSqlQuery query;
+    if (!query.exec("CREATE INDEX IF NOT EXISTS idx_items_type ON Items (itemType, itemId)")) return false;
+    if (!query.exec("CREATE INDEX IF NOT EXISTS idx_items_status ON Items (status)")) return false;
+    return true;
+}
+
+bool DatabaseManager::dropItemIndexes() {
+    QSqlQuery query;
+    if (!query.exec("DROP INDEX IF EXISTS idx_items_type")) return false;
+    if (!query.exec("DROP INDEX IF EXISTS idx_items_status")) return false;
+    if (!query.exec("DROP INDEX IF EXISTS idx_items_isbn")) return false;
+    return true;
+}
+
+// Runs EXPLAIN QUERY PLAN on the hot lookup queries and reports any that scan a whole table or sort in a temp b-tree
+bool DatabaseManager::verifyQueryPlans(QStringList* fullScans) {
+    const QStringList hotQueries = {
+        "SELECT * FROM Items WHERE itemId = :key",
+        "SELECT itemId FROM Items WHERE itemType = :key",
+        "SELECT * FROM Items WHERE itemType = :key AND itemId > x'' ORDER BY itemId LIMIT 100",
+        "SELECT itemId FROM Items WHERE status = :key",
+        "SELECT outstandingFines FROM Patrons WHERE name = :key",
+        "SELECT itemId FROM Loans WHERE patronName = :key",
+        "SELECT itemId FROM Holds WHERE patronName = :key",
+        "SELECT rowid, patronName, itemId, dueDate, accruedThrough FROM Loans WHERE accruedThrough < :key "
+        "AND dueDate < 0 AND (accruedThrough, dueDate, rowid) > (0, 0, 0) ORDER BY accruedThrough, dueDate, rowid LIMIT 100",
+        "SELECT patronName FROM Loans WHERE itemId = :key",
+        "SELECT patronName FROM Holds WHERE itemId = :key ORDER BY position",
+        "SELECT itemId, patronName FROM Holds WHERE itemId BETWEEN :key AND x'ff' ORDER BY itemId, position",
+        "SELECT MAX(position) FROM Holds WHERE itemId = :key",
+        "DELETE FROM Holds WHERE itemId = :key",
+        "SELECT seq, itemId, origin IS x'' FROM ChangeLog WHERE seq > :key ORDER BY seq",
+        "SELECT itemId FROM Items WHERE isbnNormalized = :key"
+    };
+    bool ok = true;
+    for (const QString& sql : hotQueries) {
+        QSqlQuery query;
+        query.prepare("EXPLAIN QUERY PLAN " + sql);
+        query.bindValue(":key", QString());
+        if (!query.exec()) return false;
+        while (query.next()) {
+            const QString detail = query.value("detail").toString();
+            if (detail.startsWith("SCAN ") || detail.contains("TEMP B-TREE")) {
+                ok = false;
+                if (fullScans) fullScans->append(sql + " -> " + detail);
+            }
+        }
+    }
+    return ok;
+}
+
 // Pre-seed database with default data
 bool DatabaseManager::populateDefaultData() {
     db.transaction();
@@ -142,174 +664,282 @@ bool DatabaseManager::populateDefaultData() {
 // Inserts a new catalogue item into the database
 bool DatabaseManager::saveItem(Item* item) {
     if (!item) return false;
-    QSqlQuery query;
-    query.prepare(
+    WriteCommand command("saveItem",
         "INSERT INTO Items (itemId, itemType, title, creator, publicationYear, format, condition, status, dueDate, "
-        "isbn, deweyClass, issueNumber, publicationDate, genre, rating, platform) "
+        "isbn, deweyClass, issueNumber, publicationDate, genre, rating, platform, isbnNormalized) "
         "VALUES (:itemId, :itemType, :title, :creator, :publicationYear, :format, :condition, :status, :dueDate, "
-        ":isbn, :deweyClass, :issueNumber, :publicationDate, :genre, :rating, :platform)"
+        ":isbn, :deweyClass, :issueNumber, :publicationDate, :genre, :rating, :platform, :isbnNormalized)"
     );
-    query.bindValue(":itemId", item->itemId.toString());
-    query.bindValue(":itemType", item->typeName());
-    query.bindValue(":title", item->title);
-    query.bindValue(":creator", item->creator);
-    query.bindValue(":publicationYear", item->publicationYear);
-    query.bindValue(":format", item->format);
-    QString conditionStr;
-    switch (item->condition) {
-        case ItemCondition::New: conditionStr = "New"; break;
-        case ItemCondition::Standard: conditionStr = "Standard"; break;
-        case ItemCondition::Worn: conditionStr = "Worn"; break;
-    }
-    query.bindValue(":condition", conditionStr);
-    QString statusStr;
-    switch (item->status) {
-        case ItemStatus::Available: statusStr = "Available"; break;
-        case ItemStatus::CheckedOut: statusStr = "CheckedOut"; break;
-        case ItemStatus::OnHold: statusStr = "OnHold"; break;
-    }
-    query.bindValue(":status", statusStr);
-    query.bindValue(":dueDate", item->dueDate.isValid() ? item->dueDate.toString(Qt::ISODate) : QVariant());
-    query.bindValue(":isbn", QVariant());
-    query.bindValue(":deweyClass", QVariant());
-    query.bindValue(":issueNumber", QVariant());
-    query.bindValue(":publicationDate", QVariant());
-    query.bindValue(":genre", QVariant());
-    query.bindValue(":rating", QVariant());
-    query.bindValue(":platform", QVariant());
-    if (auto* fb = dynamic_cast<FictionBook*>(item)) {
-        query.bindValue(":isbn", fb->isbn);
-    } else if (auto* nf = dynamic_cast<NonFictionBook*>(item)) {
-        query.bindValue(":isbn", nf->isbn);
-        query.bindValue(":deweyClass", nf->deweyClass);
-    } else if (auto* mag = dynamic_cast<Magazine*>(item)) {
-        query.bindValue(":issueNumber", mag->issueNumber);
-        query.bindValue(":publicationDate", mag->publicationDate.toString(Qt::ISODate));
-    } else if (auto* mov = dynamic_cast<Movie*>(item)) {
-        query.bindValue(":genre", mov->genre);
-        query.bindValue(":rating", mov->rating);
-    } else if (auto* vg = dynamic_cast<VideoGame*>(item)) {
-        query.bindValue(":genre", vg->genre);
-        query.bindValue(":platform", vg->platform);
-        query.bindValue(":rating", vg->rating);
-    }
-    return query.exec();
+    command.bind(":itemId", idValue(item->itemId));
+    command.bind(":itemType", typeValue(item->type));
+    command.bind(":title", item->title);
+    command.bind(":creator", item->creator);
+    command.bind(":publicationYear", item->publicationYear);
+    command.bind(":format", item->format);
+    command.bind(":condition", static_cast<int>(item->condition));
+    command.bind(":status", static_cast<int>(item->status));
+    command.bind(":dueDate", dateValue(item->dueDate));
+    QVariant isbn, deweyClass, issueNumber, publicationDate, genre, rating, platform;
+    switch (item->type) {
+        case ItemType::Fiction: {
+            auto* fb = static_cast<FictionBook*>(item);
+            isbn = fb->isbn;
+            break;
+        }
+        case ItemType::NonFiction: {
+            auto* nf = static_cast<NonFictionBook*>(item);
+            isbn = nf->isbn;
+            deweyClass = nf->deweyClass;
+            break;
+        }
+        case ItemType::Magazine: {
+            auto* mag = static_cast<Magazine*>(item);
+            issueNumber = mag->issueNumber;
+            publicationDate = dateValue(mag->publicationDate);
+            break;
+        }
+        case ItemType::Movie: {
+            auto* mov = static_cast<Movie*>(item);
+            genre = mov->genre;
+            rating = mov->rating;
+            break;
+        }
+        case ItemType::VideoGame: {
+            auto* vg = static_cast<VideoGame*>(item);
+            genre = vg->genre;
+            platform = vg->platform;
+            rating = vg->rating;
+            break;
+        }
+    }
+    command.bind(":isbn", isbn);
+    command.bind(":deweyClass", deweyClass);
+    command.bind(":issueNumber", issueNumber);
+    command.bind(":publicationDate", publicationDate);
+    command.bind(":genre", genre);
+    command.bind(":rating", rating);
+    command.bind(":platform", platform);
+    const QString isbnNormalized = Isbn::normalize(isbn.toString());
+    command.bind(":isbnNormalized", isbnNormalized.isEmpty() ? QVariant() : QVariant(isbnNormalized));
+    return submitWrite(command);
 }
 
 // Updates an existing item's status and due date in the database after a borrow or return
 bool DatabaseManager::updateItem(Item* item) {
     if (!item) return false;
-    QSqlQuery query;
-    query.prepare("UPDATE Items SET status = :status, dueDate = :dueDate WHERE itemId = :itemId");
-    query.bindValue(":itemId", item->itemId.toString());
-    QString statusStr;
-    switch (item->status) {
-        case ItemStatus::Available: statusStr = "Available"; break;
-        case ItemStatus::CheckedOut: statusStr = "CheckedOut"; break;
-        case ItemStatus::OnHold: statusStr = "OnHold"; break;
-    }
-    query.bindValue(":status", statusStr);
-    query.bindValue(":dueDate", item->dueDate.isValid() ? item->dueDate.toString(Qt::ISODate) : QVariant());
-    return query.exec();
+    WriteCommand command("updateItem", "UPDATE Items SET status = :status, dueDate = :dueDate WHERE itemId = :itemId");
+    command.bind(":itemId", idValue(item->itemId));
+    command.bind(":status", static_cast<int>(item->status));
+    command.bind(":dueDate", dateValue(item->dueDate));
+    return submitWrite(command);
 }
 
 // Removes an item from the database
-bool DatabaseManager::deleteItem(const QString& itemId) {
-    QSqlQuery query;
-    query.prepare("DELETE FROM Items WHERE itemId = :itemId");
-    query.bindValue(":itemId", itemId);
-    return query.exec();
+bool DatabaseManager::deleteItem(const QUuid& itemId) {
+    WriteCommand command("deleteItem", "DELETE FROM Items WHERE itemId = :itemId");
+    command.bind(":itemId", idValue(itemId));
+    return submitWrite(command);
 }
 
-// Retrieves a single item from the database
-Item* DatabaseManager::loadItemById(const QString& itemId) {
-    QSqlQuery query;
-    query.prepare("SELECT * FROM Items WHERE itemId = :itemId");
-    query.bindValue(":itemId", itemId);
-    if (!query.exec() || !query.next()) return nullptr;
-    QString itemType = query.value("itemType").toString();
+// Builds the Item subclass described by the current row of an Items query, without its hold queue. With
+// internStrings the repeated attributes are shared through the StringPool. The pool is only cleared when the eager
+// catalogue is released, so items that come and go, like lazily paged ones, keep their own copies instead
+Item* DatabaseManager::itemFromRecord(const QSqlQuery& query, ItemArena* arena, bool internStrings) {
+    const int typeCode = query.value("itemType").toInt();
+    if (typeCode < 0 || typeCode >= ItemTypeCount) return nullptr;
+    StringPool& strings = StringPool::instance();
+    auto attribute = [&](const char* column) {
+        const QString value = query.value(column).toString();
+        return internStrings ? strings.intern(value) : value;
+    };
     QString title = query.value("title").toString();
-    QString creator = query.value("creator").toString();
+    QString creator = attribute("creator");
     int year = query.value("publicationYear").toInt();
-    QString format = query.value("format").toString();
-    ItemCondition condition = ItemCondition::Standard;
-    QString condStr = query.value("condition").toString();
-    if (condStr == "New") condition = ItemCondition::New;
-    else if (condStr == "Worn") condition = ItemCondition::Worn;
+    QString format = attribute("format");
+    ItemCondition condition = conditionFromValue(query.value("condition"));
     Item* item = nullptr;
-    if (itemType == "Fiction") {
-        QString isbn = query.value("isbn").toString();
-        item = new FictionBook(title, creator, year, format, condition, isbn);
-    } else if (itemType == "Non-Fiction") {
-        QString isbn = query.value("isbn").toString();
-        QString dewey = query.value("deweyClass").toString();
-        item = new NonFictionBook(title, creator, year, format, condition, isbn, dewey);
-    } else if (itemType == "Magazine") {
-        int issue = query.value("issueNumber").toInt();
-        QDate pubDate = QDate::fromString(query.value("publicationDate").toString(), Qt::ISODate);
-        item = new Magazine(title, creator, year, format, condition, issue, pubDate);
-    } else if (itemType == "Movie") {
-        QString genre = query.value("genre").toString();
-        int rating = query.value("rating").toInt();
-        item = new Movie(title, creator, year, format, condition, genre, rating);
-    } else if (itemType == "Video Game") {
-        QString platform = query.value("platform").toString();
-        QString genre = query.value("genre").toString();
-        int rating = query.value("rating").toInt();
-        item = new VideoGame(title, creator, year, format, condition, platform, genre, rating);
+    switch (static_cast<ItemType>(typeCode)) {
+        case ItemType::Fiction: {
+            QString isbn = query.value("isbn").toString();
+            item = createItem<FictionBook>(arena, title, creator, year, format, condition, isbn);
+            break;
+        }
+        case ItemType::NonFiction: {
+            QString isbn = query.value("isbn").toString();
+            QString dewey = query.value("deweyClass").toString();
+            item = createItem<NonFictionBook>(arena, title, creator, year, format, condition, isbn, dewey);
+            break;
+        }
+        case ItemType::Magazine: {
+            int issue = query.value("issueNumber").toInt();
+            QDate pubDate = dateFromValue(query.value("publicationDate"));
+            item = createItem<Magazine>(arena, title, creator, year, format, condition, issue, pubDate);
+            break;
+        }
+        case ItemType::Movie: {
+            QString genre = attribute("genre");
+            int rating = query.value("rating").toInt();
+            item = createItem<Movie>(arena, title, creator, year, format, condition, genre, rating);
+            break;
+        }
+        case ItemType::VideoGame: {
+            QString platform = attribute("platform");
+            QString genre = attribute("genre");
+            int rating = query.value("rating").toInt();
+            item = createItem<VideoGame>(arena, title, creator, year, format, condition, platform, genre, rating);
+            break;
+        }
     }
     if (item) {
-        item->itemId = QUuid(itemId);
-        QString statusStr = query.value("status").toString();
-        if (statusStr == "CheckedOut") item->status = ItemStatus::CheckedOut;
-        else if (statusStr == "OnHold") item->status = ItemStatus::OnHold;
-        else item->status = ItemStatus::Available;
-        QString dueDateStr = query.value("dueDate").toString();
-        if (!dueDateStr.isEmpty()) {
-            item->dueDate = QDate::fromString(dueDateStr, Qt::ISODate);
-        }
+        item->itemId = QUuid::fromRfc4122(query.value("itemId").toByteArray());
+        item->status = statusFromValue(query.value("status"));
+        item->dueDate = dateFromValue(query.value("dueDate"));
+    }
+    return item;
+}
+
+// Retrieves a single item from the database, interning its attributes when it joins the eager catalogue
+Item* DatabaseManager::loadItemById(const QUuid& itemId, bool internStrings) {
+    QSqlQuery* query = cachedQuery("loadItemById", "SELECT * FROM Items WHERE itemId = :itemId");
+    if (!query) return nullptr;
+    query->bindValue(":itemId", idValue(itemId));
+    if (!query->exec() || !query->next()) { query->finish(); return nullptr; }
+    Item* item = itemFromRecord(*query, nullptr, internStrings);
+    query->finish();
+    if (item) {
         item->holdQueue = loadHoldQueueForItem(itemId);
     }
     return item;
 }
 
-// Loads all catalogue items from the database into memory
-QVector<Item*> DatabaseManager::loadAllItems() {
+// Loads up to limit items of one type whose ids sort after afterId, in id order. Pass a null afterId for the first
+// page and the last id of each page for the next one. Items are heap allocated and owned by the caller
+QVector<Item*> DatabaseManager::loadItemPage(ItemType type, const QUuid& afterId, int limit) {
     QVector<Item*> items;
-    QSqlQuery query("SELECT itemId FROM Items");
-    while (query.next()) {
-        Item* item = loadItemById(query.value(0).toString());
-        if (item) items.append(item);
+    QSqlQuery* query = cachedQuery("loadItemPage",
+        "SELECT * FROM Items WHERE itemType = :type AND itemId > :after ORDER BY itemId LIMIT :limit");
+    if (!query) return items;
+    query->bindValue(":type", typeValue(type));
+    // Every id blob sorts after the empty blob
+    query->bindValue(":after", afterId.isNull() ? QByteArray("", 0) : afterId.toRfc4122());
+    query->bindValue(":limit", limit);
+    if (query->exec()) {
+        while (query->next()) {
+            if (Item* item = itemFromRecord(*query)) items.append(item);
+        }
     }
+    query->finish();
+    if (items.isEmpty()) return items;
+
+    // One range read covers the holds of the whole page. The range also spans items of other types, whose holds
+    // the merge below skips; both sides are in itemId order, so each hold row is visited once
+    QSqlQuery* holds = cachedQuery("loadHoldsForItemRange",
+        "SELECT itemId, patronName FROM Holds WHERE itemId BETWEEN :first AND :last ORDER BY itemId, position");
+    if (!holds) return items;
+    holds->bindValue(":first", idValue(items.first()->itemId));
+    holds->bindValue(":last", idValue(items.last()->itemId));
+    if (holds->exec()) {
+        int index = 0;
+        QByteArray currentId = items[0]->itemId.toRfc4122();
+        while (holds->next()) {
+            const QByteArray holdItemId = holds->value(0).toByteArray();
+            while (index < items.size() && currentId < holdItemId) {
+                if (++index < items.size()) currentId = items[index]->itemId.toRfc4122();
+            }
+            if (index == items.size()) break;
+            if (holdItemId == currentId) items[index]->holdQueue.enqueue(holds->value(1).toString());
+        }
+    }
+    holds->finish();
     return items;
 }
 
-// Loads all patrons from the database along with their active loans and holds
-QVector<Patron> DatabaseManager::loadAllPatrons() {
-    QVector<Patron> patrons;
-    QSqlQuery query("SELECT * FROM Patrons");
-    while (query.next()) {
-        Patron patron(query.value("name").toString());
-        patron.outstandingFines = query.value("outstandingFines").toDouble();
-        QSqlQuery loanQuery;
-        loanQuery.prepare("SELECT itemId FROM Loans WHERE patronName = :name");
-        loanQuery.bindValue(":name", patron.name);
-        if (loanQuery.exec()) {
-            while (loanQuery.next()) {
-                patron.activeLoans.append(QUuid(loanQuery.value(0).toString()));
+// Loads all catalogue items in a single pass: both tables are streamed once, sorted by itemId,
+// and each item's hold queue is merged in from the Holds scan instead of being queried per item
+QVector<Item*> DatabaseManager::loadAllItems(ItemArena* arena) {
+    QVector<Item*> items;
+    QSqlQuery itemQuery;
+    if (arena && itemQuery.exec("SELECT COUNT(*) FROM Items") && itemQuery.next()) {
+        // Size the arena for the whole catalogue up front, assuming every row is the largest item type
+        const std::size_t largest = qMax(qMax(qMax(ItemArena::footprint<FictionBook>(),
+                                                   ItemArena::footprint<NonFictionBook>()),
+                                              qMax(ItemArena::footprint<Magazine>(), ItemArena::footprint<Movie>())),
+                                         ItemArena::footprint<VideoGame>());
+        const qint64 count = itemQuery.value(0).toLongLong();
+        arena->reserve(count * largest);
+        items.reserve(count);
+    }
+    itemQuery.setForwardOnly(true);
+    if (!itemQuery.exec("SELECT * FROM Items ORDER BY itemId")) return items;
+    QSqlQuery holdQuery;
+    holdQuery.setForwardOnly(true);
+    bool hasHold = holdQuery.exec("SELECT itemId, patronName FROM Holds ORDER BY itemId, position") && holdQuery.next();
+    while (itemQuery.next()) {
+        Item* item = itemFromRecord(itemQuery, arena, true);
+        if (!item) continue;
+        // Ids are compared as raw blobs, matching SQLite's memcmp ordering
+        const QByteArray itemId = itemQuery.value("itemId").toByteArray();
+        // Skip holds whose item sorts before this one (orphaned rows), then take every hold for this item
+        while (hasHold && holdQuery.value(0).toByteArray() < itemId) {
+            hasHold = holdQuery.next();
+        }
+        while (hasHold && holdQuery.value(0).toByteArray() == itemId) {
+            item->holdQueue.enqueue(holdQuery.value(1).toString());
+            hasHold = holdQuery.next();
+        }
+        items.append(item);
+    }
+    return items;
+}
+
+// Names of every patron account, without their loans or holds
+QStringList DatabaseManager::loadPatronNames() {
+    QStringList names;
+    QSqlQuery query;
+    query.setForwardOnly(true);
+    if (query.exec("SELECT name FROM Patrons ORDER BY name")) {
+        while (query.next()) {
+            names.append(query.value(0).toString());
+        }
+    }
+    return names;
+}
+
+// Loads one patron's fines, loans and holds through the Patrons and (patronName, itemId) primary keys.
+// Returns false if there is no such patron
+bool DatabaseManager::loadPatron(const QString& name, Patron& patron) {
+    QSqlQuery* query = cachedQuery("loadPatron", "SELECT outstandingFines FROM Patrons WHERE name = :name");
+    if (!query) return false;
+    query->bindValue(":name", name);
+    if (!query->exec() || !query->next()) {
+        query->finish();
+        return false;
+    }
+    patron = Patron(name);
+    patron.outstandingFines = query->value(0).toDouble();
+    query->finish();
+
+    QSqlQuery* loanQuery = cachedQuery("loadPatronLoans", "SELECT itemId FROM Loans WHERE patronName = :name");
+    if (loanQuery) {
+        loanQuery->bindValue(":name", name);
+        if (loanQuery->exec()) {
+            while (loanQuery->next()) {
+                patron.activeLoans.append(QUuid::fromRfc4122(loanQuery->value(0).toByteArray()));
             }
         }
-        QSqlQuery holdQuery;
-        holdQuery.prepare("SELECT itemId FROM Holds WHERE patronName = :name");
-        holdQuery.bindValue(":name", patron.name);
-        if (holdQuery.exec()) {
-            while (holdQuery.next()) {
-                patron.activeHolds.append(QUuid(holdQuery.value(0).toString()));
+        loanQuery->finish();
+    }
+    QSqlQuery* holdQuery = cachedQuery("loadPatronHolds", "SELECT itemId FROM Holds WHERE patronName = :name");
+    if (holdQuery) {
+        holdQuery->bindValue(":name", name);
+        if (holdQuery->exec()) {
+            while (holdQuery->next()) {
+                patron.activeHolds.append(QUuid::fromRfc4122(holdQuery->value(0).toByteArray()));
             }
         }
-        patrons.append(patron);
+        holdQuery->finish();
     }
-    return patrons;
+    return true;
 }
 
 QVector<Librarian> DatabaseManager::loadAllLibrarians() {
@@ -330,74 +960,490 @@ QVector<SystemAdmin> DatabaseManager::loadAllSystemAdmins() {
     return admins;
 }
 
+// Creates a patron account row. Fails if the name is already taken
+bool DatabaseManager::savePatron(const Patron& patron) {
+    WriteCommand command("savePatron", "INSERT INTO Patrons (name, outstandingFines) VALUES (:name, :fines)");
+    command.bind(":name", patron.name);
+    command.bind(":fines", patron.outstandingFines);
+    return submitWrite(command);
+}
+
 bool DatabaseManager::updatePatron(const Patron& patron) {
-    QSqlQuery query;
-    query.prepare("UPDATE Patrons SET outstandingFines = :fines WHERE name = :name");
-    query.bindValue(":name", patron.name);
-    query.bindValue(":fines", patron.outstandingFines);
-    return query.exec();
+    WriteCommand command("updatePatron", "UPDATE Patrons SET outstandingFines = :fines WHERE name = :name");
+    command.bind(":name", patron.name);
+    command.bind(":fines", patron.outstandingFines);
+    return submitWrite(command);
 }
 
 // Records a new loan in the database linking a patron to an item with a due date
-bool DatabaseManager::saveLoan(const QString& patronName, const QString& itemId, const QDate& dueDate) {
-    QSqlQuery query;
-    query.prepare("INSERT OR REPLACE INTO Loans (patronName, itemId, dueDate) VALUES (:patron, :item, :due)");
-    query.bindValue(":patron", patronName);
-    query.bindValue(":item", itemId);
-    query.bindValue(":due", dueDate.toString(Qt::ISODate));
-    return query.exec();
+bool DatabaseManager::saveLoan(const QString& patronName, const QUuid& itemId, const QDate& dueDate) {
+    WriteCommand command("saveLoan",
+        "INSERT OR REPLACE INTO Loans (patronName, itemId, dueDate, accruedThrough) "
+        "VALUES (:patron, :item, :due, :accrued)");
+    command.bind(":patron", patronName);
+    command.bind(":item", idValue(itemId));
+    command.bind(":due", dateValue(dueDate));
+    // Nothing is owed up to the due date
+    command.bind(":accrued", dateValue(dueDate));
+    return submitWrite(command);
 }
 
-bool DatabaseManager::deleteLoan(const QString& patronName, const QString& itemId) {
-    QSqlQuery query;
-    query.prepare("DELETE FROM Loans WHERE patronName = :patron AND itemId = :item");
-    query.bindValue(":patron", patronName);
-    query.bindValue(":item", itemId);
-    return query.exec();
+bool DatabaseManager::deleteLoan(const QString& patronName, const QUuid& itemId) {
+    WriteCommand command("deleteLoan", "DELETE FROM Loans WHERE patronName = :patron AND itemId = :item");
+    command.bind(":patron", patronName);
+    command.bind(":item", idValue(itemId));
+    return submitWrite(command);
 }
 
-// Saves a hold request to the database with the patrons position in the queue
-bool DatabaseManager::saveHold(const QString& patronName, const QString& itemId, int position) {
-    QSqlQuery query;
-    query.prepare("INSERT OR REPLACE INTO Holds (patronName, itemId, position) VALUES (:patron, :item, :pos)");
-    query.bindValue(":patron", patronName);
-    query.bindValue(":item", itemId);
-    query.bindValue(":pos", position);
-    return query.exec();
+// Reads overdue loans not yet accrued through asOf, in (accruedThrough, dueDate, rowid) order by seeking
+// idx_loans_accrual. Pass invalid dates for the first batch and the accruedThrough, dueDate and rowId of the last
+// loan of each batch for the next one. Loans charged in between move past asOf and drop out of the range
+QVector<DatabaseManager::OverdueLoan> DatabaseManager::loadOverdueLoans(const QDate& asOf, const QDate& afterAccrued,
+                                                                         const QDate& afterDue, qint64 afterRowId,
+                                                                         int limit) {
+    QVector<OverdueLoan> loans;
+    QSqlQuery* query = cachedQuery("loadOverdueLoans",
+        "SELECT rowid, patronName, itemId, dueDate, accruedThrough FROM Loans "
+        "WHERE accruedThrough < :accruedAsOf AND dueDate < :asOf "
+        "AND (accruedThrough, dueDate, rowid) > (:afterAccrued, :afterDue, :afterRow) "
+        "ORDER BY accruedThrough, dueDate, rowid LIMIT :limit");
+    if (!query) return loans;
+    query->bindValue(":asOf", dateValue(asOf));
+    query->bindValue(":accruedAsOf", dateValue(asOf));
+    // Julian day 0 sorts before every real date
+    query->bindValue(":afterAccrued", afterAccrued.isValid() ? afterAccrued.toJulianDay() : qint64(0));
+    query->bindValue(":afterDue", afterDue.isValid() ? afterDue.toJulianDay() : qint64(0));
+    query->bindValue(":afterRow", afterRowId);
+    query->bindValue(":limit", limit);
+    if (query->exec()) {
+        loans.reserve(limit);
+        while (query->next()) {
+            loans.append({query->value(0).toLongLong(), query->value(1).toString(),
+                          QUuid::fromRfc4122(query->value(2).toByteArray()),
+                          dateFromValue(query->value(3)), dateFromValue(query->value(4))});
+        }
+    }
+    query->finish();
+    return loans;
 }
 
-bool DatabaseManager::deleteHold(const QString& patronName, const QString& itemId) {
-    QSqlQuery query;
-    query.prepare("DELETE FROM Holds WHERE patronName = :patron AND itemId = :item");
-    query.bindValue(":patron", patronName);
-    query.bindValue(":item", itemId);
-    return query.exec();
+// Reads one patron's loans not yet accrued through asOf, through the (patronName, itemId) primary key
+QVector<DatabaseManager::OverdueLoan> DatabaseManager::loadOverdueLoansForPatron(const QString& patronName,
+                                                                                  const QDate& asOf) {
+    QVector<OverdueLoan> loans;
+    QSqlQuery* query = cachedQuery("loadOverdueLoansForPatron",
+        "SELECT rowid, itemId, dueDate, accruedThrough FROM Loans "
+        "WHERE patronName = :patron AND dueDate < :asOf AND accruedThrough < :accruedAsOf");
+    if (!query) return loans;
+    query->bindValue(":patron", patronName);
+    query->bindValue(":asOf", dateValue(asOf));
+    query->bindValue(":accruedAsOf", dateValue(asOf));
+    if (query->exec()) {
+        while (query->next()) {
+            loans.append({query->value(0).toLongLong(), patronName,
+                          QUuid::fromRfc4122(query->value(1).toByteArray()),
+                          dateFromValue(query->value(2)), dateFromValue(query->value(3))});
+        }
+    }
+    query->finish();
+    return loans;
+}
+
+// Moves a loan's fines watermark forward to through
+bool DatabaseManager::markLoanAccrued(const QString& patronName, const QUuid& itemId, const QDate& through) {
+    WriteCommand command("markLoanAccrued",
+        "UPDATE Loans SET accruedThrough = :through WHERE patronName = :patron AND itemId = :item");
+    command.bind(":patron", patronName);
+    command.bind(":item", idValue(itemId));
+    command.bind(":through", dateValue(through));
+    return submitWrite(command);
+}
+
+// Adds amount to a patron's stored fines in place, so concurrent writers never overwrite each other's accruals
+bool DatabaseManager::addPatronFine(const QString& patronName, double amount) {
+    WriteCommand command("addPatronFine",
+        "UPDATE Patrons SET outstandingFines = outstandingFines + :amount WHERE name = :name");
+    command.bind(":name", patronName);
+    command.bind(":amount", amount);
+    return submitWrite(command);
+}
+
+// Saves a hold request to the database at an explicit queue position
+bool DatabaseManager::saveHold(const QString& patronName, const QUuid& itemId, qint64 position) {
+    WriteCommand command("saveHold", "INSERT OR REPLACE INTO Holds (patronName, itemId, position) VALUES (:patron, :item, :pos)");
+    command.bind(":patron", patronName);
+    command.bind(":item", idValue(itemId));
+    command.bind(":pos", position);
+    return submitWrite(command);
+}
+
+// Adds a hold to the back of an item's queue. Positions are sparse: each new hold goes HoldPositionGap past the
+// current last one, found through the (itemId, position) index, so removing any hold never renumbers the others
+bool DatabaseManager::appendHold(const QString& patronName, const QUuid& itemId) {
+    WriteCommand command("appendHold",
+        "INSERT OR REPLACE INTO Holds (patronName, itemId, position) "
+        "SELECT :patron, :item, COALESCE(MAX(position), 0) + :gap FROM Holds WHERE itemId = :queueItem"
+    );
+    command.bind(":patron", patronName);
+    command.bind(":item", idValue(itemId));
+    command.bind(":gap", HoldPositionGap);
+    command.bind(":queueItem", idValue(itemId));
+    return submitWrite(command);
+}
+
+bool DatabaseManager::deleteHold(const QString& patronName, const QUuid& itemId) {
+    WriteCommand command("deleteHold", "DELETE FROM Holds WHERE patronName = :patron AND itemId = :item");
+    command.bind(":patron", patronName);
+    command.bind(":item", idValue(itemId));
+    return submitWrite(command);
 }
 
 // Retrieves the ordered list of patron names waiting for a specific item
-QVector<QString> DatabaseManager::loadHoldQueueForItem(const QString& itemId) {
-    QVector<QString> queue;
-    QSqlQuery query;
-    query.prepare("SELECT patronName FROM Holds WHERE itemId = :item ORDER BY position");
-    query.bindValue(":item", itemId);
-    if (query.exec()) {
-        while (query.next()) {
-            queue.append(query.value(0).toString());
+HoldQueue DatabaseManager::loadHoldQueueForItem(const QUuid& itemId) {
+    HoldQueue queue;
+    QSqlQuery* query = cachedQuery("loadHoldQueueForItem", "SELECT patronName FROM Holds WHERE itemId = :item ORDER BY position");
+    if (!query) return queue;
+    query->bindValue(":item", idValue(itemId));
+    if (query->exec()) {
+        while (query->next()) {
+            queue.enqueue(query->value(0).toString());
         }
     }
+    query->finish();
     return queue;
 }
 
-// Recalculates and saves hold queue positions after a hold is cancelled or fulfilled
-bool DatabaseManager::updateHoldPositions(const QString& itemId, const QVector<QString>& queue) {
-    db.transaction();
-    QSqlQuery deleteQuery;
-    deleteQuery.prepare("DELETE FROM Holds WHERE itemId = :item");
-    deleteQuery.bindValue(":item", itemId);
-    if (!deleteQuery.exec()) { db.rollback(); return false; }
-    for (int i = 0; i < queue.size(); ++i) {
-        if (!saveHold(queue[i], itemId, i)) { db.rollback(); return false; }
+// Starts a unit of work grouping every write of one operation into a single transaction. Units of work nest:
+// only the outermost begin/commit pair touches the database, and a rollback at any level fails the whole unit.
+// With write-behind enabled the unit's writes are collected into one batch instead of opening a transaction
+bool DatabaseManager::beginUnitOfWork() {
+    if (unitOfWorkDepth++ > 0) return true;
+    unitOfWorkFailed = false;
+    if (writeBehindActive()) {
+        pendingBatch.clear();
+        return true;
+    }
+    if (!db.transaction()) {
+        unitOfWorkDepth = 0;
+        return false;
+    }
+    return true;
+}
+
+// Commits the unit of work once the outermost level finishes. Returns false, leaving the database unchanged,
+// if the commit fails or any nested level rolled back. With write-behind enabled the batch is only queued for the
+// worker and this returns without waiting: if the worker later rolls it back, dispatchWriteCompletions() runs
+// onRolledBack. Callers that must not go on before the write is durable wait with waitForUnitOfWork(). Only the
+// outermost level's handler is kept
+bool DatabaseManager::commitUnitOfWork(const RollbackHandler& onRolledBack) {
+    if (unitOfWorkDepth == 0) return false;
+    if (--unitOfWorkDepth > 0) return !unitOfWorkFailed;
+    lastUnitTicket = 0;
+    if (writeBehindActive()) {
+        WriteBatch batch;
+        batch.swap(pendingBatch);
+        if (unitOfWorkFailed) return false;
+        if (batch.isEmpty()) return true;
+        const qint64 ticket = writer->enqueue(batch, true);
+        if (ticket == 0) return false;
+        lastUnitTicket = ticket;
+        unsettledUnits.insert(ticket, onRolledBack);
+        return true;
+    }
+    if (unitOfWorkFailed || !db.commit()) {
+        qWarning() << "Unit of work rolled back:" << db.lastError().text();
+        db.rollback();
+        return false;
+    }
+    return true;
+}
+
+void DatabaseManager::rollbackUnitOfWork() {
+    if (unitOfWorkDepth == 0) return;
+    unitOfWorkFailed = true;
+    if (--unitOfWorkDepth > 0) return;
+    if (writeBehindActive()) {
+        pendingBatch.clear();
+        return;
+    }
+    db.rollback();
+}
+
+// Ticket of the unit of work the last commitUnitOfWork() queued, for waitForUnitOfWork(). 0 if it queued nothing
+qint64 DatabaseManager::lastUnitOfWorkTicket() const {
+    return lastUnitTicket;
+}
+
+// Blocks until the unit of work with the given ticket is committed. Returns true at once without write-behind,
+// where commitUnitOfWork() has already committed. If the worker rolled the unit back, its handler runs here
+bool DatabaseManager::waitForUnitOfWork(qint64 ticket) {
+    if (!writer || ticket <= 0) return true;
+    const bool committed = writer->waitFor(ticket);
+    const RollbackHandler handler = unsettledUnits.take(ticket);
+    if (!committed) {
+        qWarning() << "Unit of work rolled back by the write-behind worker";
+        if (handler) handler();
+    }
+    return committed;
+}
+
+// Settles the units of work the write-behind worker has finished: committed ones are forgotten and the handlers
+// of rolled-back ones run. Main thread only, and not from inside a service call; a UI timer is the intended
+// caller. Returns the number of units rolled back
+int DatabaseManager::dispatchWriteCompletions() {
+    if (!writer || unsettledUnits.isEmpty()) return 0;
+    // A failure is recorded before its ticket counts as completed, so reading the completed ticket first cannot
+    // miss one
+    const qint64 completed = writer->completedThrough();
+    const QSet<qint64> failed = writer->takeFailedTickets(completed);
+    QVector<RollbackHandler> rollbacks;
+    int rolledBack = 0;
+    for (auto it = unsettledUnits.begin(); it != unsettledUnits.end() && it.key() <= completed;) {
+        if (failed.contains(it.key())) {
+            ++rolledBack;
+            if (it.value()) rollbacks.append(it.value());
+        }
+        it = unsettledUnits.erase(it);
+    }
+    if (rolledBack > 0) qWarning() << rolledBack << "units of work rolled back by the write-behind worker";
+    for (const RollbackHandler& handler : rollbacks) {
+        handler();
+    }
+    return rolledBack;
+}
+
+// Executes a write on the main connection, or hands it to the write-behind worker when one is running.
+// Inside a unit of work, write-behind commands are held back until the unit commits
+bool DatabaseManager::submitWrite(const WriteCommand& command) {
+    if (writeBehindActive()) {
+        if (unitOfWorkDepth > 0) {
+            pendingBatch.append(command);
+            return true;
+        }
+        return writer->enqueue(WriteBatch{command}) != 0;
+    }
+    QSqlQuery* query = cachedQuery(command.statementId, command.sql);
+    if (!query) return false;
+    for (const auto& binding : command.bindings) {
+        query->bindValue(binding.first, binding.second);
+    }
+    return query->exec();
+}
+
+// Moves all further writes onto a background thread with its own connection. queueCapacity bounds the number of
+// pending batches (callers block when it is full) and maxGroupSize caps how many batches share one commit.
+// Returns false, leaving writes synchronous, if the worker's connection cannot be opened or set up
+bool DatabaseManager::startWriteBehind(int queueCapacity, int maxGroupSize) {
+    if (writer) return true;
+    if (!db.isOpen() || unitOfWorkDepth > 0) return false;
+    writer = new PersistenceWorker(db.databaseName(), connectionSetup, queueCapacity, maxGroupSize);
+    writer->start();
+    if (!writer->waitForStartup()) {
+        delete writer;
+        writer = nullptr;
+        return false;
     }
-    db.commit();
     return true;
 }
+
+// Blocks until every queued write has been committed. Returns false if any batch failed since the last flush
+bool DatabaseManager::flushWrites() {
+    return writer ? writer->flush() : true;
+}
+
+// Number of fire-and-forget writes that failed on the write-behind worker since the last call. Units of work report
+// their failures through dispatchWriteCompletions() or waitForUnitOfWork() and are not counted
+int DatabaseManager::takeFailedWriteCount() {
+    return writer ? writer->takeFailedBatchCount() : 0;
+}
+
+// Bulk loads bypass the write-behind queue so large transactions are not buffered in memory
+bool DatabaseManager::writeBehindActive() const {
+    return writer && !bulkLoading;
+}
+
+// Drains the write-behind queue and returns to synchronous writes on the main connection
+void DatabaseManager::stopWriteBehind() {
+    if (!writer) return;
+    writer->stop();
+    // Every queued unit has completed now; run the rollbacks of any that failed
+    dispatchWriteCompletions();
+    if (writer->failedBatchCount() > 0) {
+        qWarning() << writer->failedBatchCount() << "write-behind batches failed";
+    }
+    delete writer;
+    writer = nullptr;
+}
+
+// Column order of the rows accepted by insertItemRows()
+QStringList DatabaseManager::itemColumns() {
+    return {"itemId", "itemType", "title", "creator", "publicationYear", "format", "condition", "status", "dueDate",
+            "isbn", "deweyClass", "issueNumber", "publicationDate", "genre", "rating", "platform", "isbnNormalized"};
+}
+
+// Switches to direct writes on the main connection for a bulk load: pending write-behind batches are flushed and
+// the Items secondary indexes are dropped so they can be rebuilt once in endBulkLoad(). The Items change triggers
+// are dropped as well; the whole load is logged as a single full-reload entry instead of one entry per row
+bool DatabaseManager::beginBulkLoad() {
+    if (bulkLoading || unitOfWorkDepth > 0) return false;
+    if (!flushWrites()) return false;
+    bulkLoading = true;
+    if (!dropItemIndexes() || !dropChangeTriggers("Items")) {
+        createChangeTriggers("Items");
+        bulkLoading = false;
+        return false;
+    }
+    return true;
+}
+
+bool DatabaseManager::endBulkLoad() {
+    if (!bulkLoading) return false;
+    bulkLoading = false;
+    QSqlQuery query;
+    bool ok = createChangeTriggers("Items");
+    ok = query.exec("INSERT INTO ChangeLog (itemId) VALUES (NULL)") && ok;
+    return createItemIndexes() && createIsbnIndex() && ok;
+}
+
+// Inserts a block of Items rows with one multi-row INSERT. Each row holds values in itemColumns() order
+bool DatabaseManager::insertItemRows(const QVector<QVariantList>& rows) {
+    if (rows.isEmpty()) return true;
+    const QStringList columns = itemColumns();
+    const QString placeholders = "(" + QString("?, ").repeated(columns.size() - 1) + "?)";
+    QStringList values;
+    for (int i = 0; i < rows.size(); ++i) values.append(placeholders);
+    QSqlQuery* query = cachedQuery(QString("insertItemRows:%1").arg(rows.size()),
+        "INSERT OR REPLACE INTO Items (" + columns.join(", ") + ") VALUES " + values.join(", "));
+    if (!query) return false;
+    int position = 0;
+    for (const QVariantList& row : rows) {
+        if (row.size() != columns.size()) return false;
+        for (const QVariant& value : row) {
+            query->bindValue(position++, value);
+        }
+    }
+    return query->exec();
+}
+
+// Records how far an import of source has got; written in the same transaction as the rows it covers
+bool DatabaseManager::saveImportCheckpoint(const QString& source, qint64 byteOffset, qint64 records) {
+    QSqlQuery* query = cachedQuery("saveImportCheckpoint",
+        "INSERT OR REPLACE INTO ImportCheckpoints (source, byteOffset, records) VALUES (:source, :offset, :records)");
+    if (!query) return false;
+    query->bindValue(":source", source);
+    query->bindValue(":offset", byteOffset);
+    query->bindValue(":records", records);
+    return query->exec();
+}
+
+// Returns false if there is no checkpoint for source
+bool DatabaseManager::loadImportCheckpoint(const QString& source, qint64& byteOffset, qint64& records) {
+    QSqlQuery* query = cachedQuery("loadImportCheckpoint",
+        "SELECT byteOffset, records FROM ImportCheckpoints WHERE source = :source");
+    if (!query) return false;
+    query->bindValue(":source", source);
+    bool found = query->exec() && query->next();
+    if (found) {
+        byteOffset = query->value(0).toLongLong();
+        records = query->value(1).toLongLong();
+    }
+    query->finish();
+    return found;
+}
+
+// Highest sequence number ever handed out by the change log, including entries that have since been pruned
+qint64 DatabaseManager::latestChangeSeq() {
+    QSqlQuery* query = cachedQuery("latestChangeSeq", "SELECT seq FROM sqlite_sequence WHERE name = 'ChangeLog'");
+    if (!query) return 0;
+    qint64 seq = query->exec() && query->next() ? query->value(0).toLongLong() : 0;
+    query->finish();
+    return seq;
+}
+
+// Collects the distinct items changed after seq by other processes, in the order they were first changed. Entries
+// this process wrote only advance lastSeq; its bulk load markers still request a full reload
+DatabaseManager::ChangeSet DatabaseManager::loadChangesSince(qint64 seq) {
+    ChangeSet changes{QVector<QUuid>(), seq, false};
+    QSqlQuery* oldest = cachedQuery("oldestChangeSeq", "SELECT MIN(seq) FROM ChangeLog");
+    if (!oldest || !oldest->exec() || !oldest->next()) {
+        changes.fullReload = true;
+        return changes;
+    }
+    const QVariant oldestSeq = oldest->value(0);
+    oldest->finish();
+    // Entries after seq were pruned before this caller read them
+    const bool pruned = oldestSeq.isNull() ? latestChangeSeq() > seq : oldestSeq.toLongLong() > seq + 1;
+    if (pruned) {
+        changes.fullReload = true;
+        changes.lastSeq = latestChangeSeq();
+        return changes;
+    }
+
+    QSqlQuery* query = cachedQuery("loadChangesSince",
+        "SELECT seq, itemId, origin IS :origin FROM ChangeLog WHERE seq > :seq ORDER BY seq");
+    if (!query) {
+        changes.fullReload = true;
+        return changes;
+    }
+    query->bindValue(":seq", seq);
+    query->bindValue(":origin", changeOrigin);
+    if (!query->exec()) {
+        query->finish();
+        changes.fullReload = true;
+        return changes;
+    }
+    QSet<QByteArray> seen;
+    while (query->next()) {
+        changes.lastSeq = query->value(0).toLongLong();
+        const QVariant itemId = query->value(1);
+        if (itemId.isNull()) {
+            changes.fullReload = true;
+            continue;
+        }
+        if (query->value(2).toBool()) continue;
+        const QByteArray id = itemId.toByteArray();
+        if (seen.contains(id)) continue;
+        seen.insert(id);
+        changes.itemIds.append(QUuid::fromRfc4122(id));
+    }
+    query->finish();
+    if (changes.fullReload) changes.itemIds.clear();
+    return changes;
+}
+
+// Deletes change log entries up to and including throughSeq. Readers that have not reached it fall back to a
+// full reload
+bool DatabaseManager::pruneChangeLog(qint64 throughSeq) {
+    WriteCommand command("pruneChangeLog", "DELETE FROM ChangeLog WHERE seq <= :seq");
+    command.bind(":seq", throughSeq);
+    return submitWrite(command);
+}
+
+// Retention policy for the change log: keeps the newest ChangeLogRetention entries and prunes the rest. A terminal
+// that falls further behind reloads its whole catalogue instead of replaying the log, so no terminal's position
+// has to be tracked. Issues no write when nothing is old enough
+bool DatabaseManager::trimChangeLog() {
+    const qint64 throughSeq = latestChangeSeq() - ChangeLogRetention;
+    if (throughSeq <= 0) return true;
+    QSqlQuery* oldest = cachedQuery("oldestChangeSeq", "SELECT MIN(seq) FROM ChangeLog");
+    if (!oldest || !oldest->exec() || !oldest->next()) return false;
+    const QVariant oldestSeq = oldest->value(0);
+    oldest->finish();
+    if (oldestSeq.isNull() || oldestSeq.toLongLong() > throughSeq) return true;
+    return pruneChangeLog(throughSeq);
+}
+
+// Ids of the items whose ISBN normalizes to isbn, which must already be in normalized form
+QVector<QUuid> DatabaseManager::findItemIdsByIsbn(const QString& isbn) {
+    QVector<QUuid> ids;
+    QSqlQuery* query = cachedQuery("findItemIdsByIsbn", "SELECT itemId FROM Items WHERE isbnNormalized = :isbn");
+    if (!query) return ids;
+    query->bindValue(":isbn", isbn);
+    if (query->exec()) {
+        while (query->next()) {
+            ids.append(QUuid::fromRfc4122(query->value(0).toByteArray()));
+        }
+    }
+    query->finish();
+    return ids;
+}
@@ -2,36 +2,122 @@
 #define DATABASEMANAGER_H
 
 #include <QSqlDatabase>
+#include <QSqlQuery>
 #include <QString>
+#include <QStringList>
 #include <QVector>
+#include <QVariant>
+#include <QHash>
+#include <QMap>
+#include <functional>
 #include "Item.h"
 #include "User.h"
+#include "PersistenceWorker.h"
+#include "ItemArena.h"
+
+enum class PerformanceProfile {
+    Durable,
+    Balanced,
+    Throughput
+};
+
+enum class CheckpointMode {
+    Passive,
+    Full,
+    Restart,
+    Truncate
+};
 
 class DatabaseManager {
 public:
+    // Restores the in-memory state of a unit of work that the write-behind worker rolled back after
+    // commitUnitOfWork() had accepted it
+    typedef std::function<void()> RollbackHandler;
+
+    // Items changed since a change log sequence number. fullReload is set when the log cannot describe the changes
+    // item by item, either because a bulk load replaced the catalogue or because the entries were pruned
+    struct ChangeSet {
+        QVector<QUuid> itemIds;
+        qint64 lastSeq;
+        bool fullReload;
+    };
+
+    // A loan whose fines watermark is behind the accrual date. accruedThrough, dueDate and rowId form the keyset
+    // cursor for batched passes
+    struct OverdueLoan {
+        qint64 rowId;
+        QString patronName;
+        QUuid itemId;
+        QDate dueDate;
+        QDate accruedThrough;
+    };
+
+    struct StatementCacheStats {
+        int hits;
+        int misses;
+    };
+
     static DatabaseManager& instance();
 
-    bool initialize(const QString& dbPath = "hinlibs.sqlite3");
+    bool initialize(const QString& dbPath = "hinlibs.sqlite3",
+                    PerformanceProfile profile = PerformanceProfile::Balanced);
     void close();
+    bool checkpoint(CheckpointMode mode = CheckpointMode::Passive);
 
-    QVector<Item*> loadAllItems();
+    QVector<Item*> loadAllItems(ItemArena* arena = nullptr);
     bool saveItem(Item* item);
     bool updateItem(Item* item);
-    bool deleteItem(const QString& itemId);
-    Item* loadItemById(const QString& itemId);
+    bool deleteItem(const QUuid& itemId);
+    Item* loadItemById(const QUuid& itemId, bool internStrings = false);
+    QVector<Item*> loadItemPage(ItemType type, const QUuid& afterId, int limit);
+    QVector<QUuid> findItemIdsByIsbn(const QString& isbn);
 
-    QVector<Patron> loadAllPatrons();
+    QStringList loadPatronNames();
+    bool loadPatron(const QString& name, Patron& patron);
     QVector<Librarian> loadAllLibrarians();
     QVector<SystemAdmin> loadAllSystemAdmins();
+    bool savePatron(const Patron& patron);
     bool updatePatron(const Patron& patron);
 
-    bool saveLoan(const QString& patronName, const QString& itemId, const QDate& dueDate);
-    bool deleteLoan(const QString& patronName, const QString& itemId);
+    bool saveLoan(const QString& patronName, const QUuid& itemId, const QDate& dueDate);
+    bool deleteLoan(const QString& patronName, const QUuid& itemId);
+    QVector<OverdueLoan> loadOverdueLoans(const QDate& asOf, const QDate& afterAccrued, const QDate& afterDue,
+                                          qint64 afterRowId, int limit);
+    QVector<OverdueLoan> loadOverdueLoansForPatron(const QString& patronName, const QDate& asOf);
+    bool markLoanAccrued(const QString& patronName, const QUuid& itemId, const QDate& through);
+    bool addPatronFine(const QString& patronName, double amount);
+
+    bool saveHold(const QString& patronName, const QUuid& itemId, qint64 position);
+    bool appendHold(const QString& patronName, const QUuid& itemId);
+    bool deleteHold(const QString& patronName, const QUuid& itemId);
+    HoldQueue loadHoldQueueForItem(const QUuid& itemId);
+
+    bool beginUnitOfWork();
+    bool commitUnitOfWork(const RollbackHandler& onRolledBack = RollbackHandler());
+    void rollbackUnitOfWork();
+    qint64 lastUnitOfWorkTicket() const;
+    bool waitForUnitOfWork(qint64 ticket);
+    int dispatchWriteCompletions();
+
+    bool startWriteBehind(int queueCapacity = 256, int maxGroupSize = 64);
+    bool flushWrites();
+    int takeFailedWriteCount();
+    void stopWriteBehind();
 
-    bool saveHold(const QString& patronName, const QString& itemId, int position);
-    bool deleteHold(const QString& patronName, const QString& itemId);
-    QVector<QString> loadHoldQueueForItem(const QString& itemId);
-    bool updateHoldPositions(const QString& itemId, const QVector<QString>& queue);
+    static QStringList itemColumns();
+    bool beginBulkLoad();
+    bool endBulkLoad();
+    bool insertItemRows(const QVector<QVariantList>& rows);
+    bool saveImportCheckpoint(const QString& source, qint64 byteOffset, qint64 records);
+    bool loadImportCheckpoint(const QString& source, qint64& byteOffset, qint64& records);
+
+    qint64 latestChangeSeq();
+    ChangeSet loadChangesSince(qint64 seq);
+    bool pruneChangeLog(qint64 throughSeq);
+    bool trimChangeLog();
+
+    StatementCacheStats statementCacheStats() const;
+    bool verifyQueryPlans(QStringList* fullScans = nullptr);
 
 private:
     DatabaseManager();
@@ -39,10 +125,56 @@ private:
     DatabaseManager(const DatabaseManager&) = delete;
     DatabaseManager& operator=(const DatabaseManager&) = delete;
 
+    static const int CurrentSchemaVersion = 10;
+    static const qint64 HoldPositionGap = 1024;
+    static const qint64 ChangeLogRetention = 10000;
+
+    static QStringList profilePragmas(PerformanceProfile profile);
+    bool applyPerformanceProfile(PerformanceProfile profile);
     bool createTables();
+    int schemaVersion();
+    bool migrateSchema();
+    bool migrateToV1();
+    bool migrateToV2();
+    bool migrateToV3();
+    bool migrateToV4();
+    bool migrateToV5();
+    bool migrateToV6();
+    bool migrateToV7();
+    bool migrateToV8();
+    bool migrateToV9();
+    bool migrateToV10();
+    bool installChangeOriginTrigger();
+    bool createIsbnIndex();
+    bool createChangeTriggers(const QString& table, const QString& updateColumns = QString());
+    bool dropChangeTriggers(const QString& table);
+    bool createCirculationIndexes();
+    bool createItemIndexes();
+    bool dropItemIndexes();
     bool populateDefaultData();
+    Item* itemFromRecord(const QSqlQuery& query, ItemArena* arena = nullptr, bool internStrings = false);
+    QSqlQuery* cachedQuery(const QString& id, const QString& sql);
+    void clearStatementCache();
+    bool submitWrite(const WriteCommand& command);
+    bool writeBehindActive() const;
 
     QSqlDatabase db;
+    QHash<QString, QSqlQuery*> statementCache;
+    int statementCacheHits;
+    int statementCacheMisses;
+    int unitOfWorkDepth;
+    bool unitOfWorkFailed;
+    // Statements run on every connection this process opens: the profile pragmas and the change origin trigger
+    QStringList connectionSetup;
+    PersistenceWorker* writer;
+    WriteBatch pendingBatch;
+    // Ticket of the last unit of work handed to the write-behind worker
+    qint64 lastUnitTicket;
+    // Units of work queued but not yet settled, by ticket, with the handler to run if the worker rolls them back
+    QMap<qint64, RollbackHandler> unsettledUnits;
+    bool bulkLoading;
+    // Random tag written to the ChangeLog rows of this process, so loadChangesSince() can skip its own writes
+    QByteArray changeOrigin;
 };
 
 #endif // DATABASEMANAGER_H
@@ -0,0 +1,186 @@
+#include "FacetIndex.h"
+#include "StringPool.h"
+#include "Movie.h"
+#include "VideoGame.h"
+#include <algorithm>
+
+void FacetIndex::addItem(Item* item) {
+    if (!item) return;
+    for (int f = 0; f < FacetCount; ++f) {
+        addPosting(static_cast<Facet>(f), facetValue(item, static_cast<Facet>(f)), item);
+    }
+}
+
+// Must be called while the item still has the values it was indexed with
+void FacetIndex::removeItem(Item* item) {
+    if (!item) return;
+    for (int f = 0; f < FacetCount; ++f) {
+        removePosting(static_cast<Facet>(f), facetValue(item, static_cast<Facet>(f)), item);
+    }
+}
+
+// Moves an item to the posting list of its current status
+void FacetIndex::updateStatus(Item* item, ItemStatus previousStatus) {
+    if (!item || item->status == previousStatus) return;
+    removePosting(Facet::Status, statusValue(previousStatus), item);
+    addPosting(Facet::Status, statusValue(item->status), item);
+}
+
+void FacetIndex::clear() {
+    for (int f = 0; f < FacetCount; ++f) {
+        postings[f].clear();
+        lastValue[f].clear();
+        lastPostings[f] = nullptr;
+    }
+}
+
+// Number of items per value of a facet across the whole catalogue
+QMap<QString, int> FacetIndex::counts(Facet facet) const {
+    QMap<QString, int> result;
+    const QHash<QString, Postings>& facetPostings = postings[static_cast<int>(facet)];
+    for (auto it = facetPostings.constBegin(); it != facetPostings.constEnd(); ++it) {
+        result.insert(it.key(), it.value().size());
+    }
+    return result;
+}
+
+// Number of items per value of a facet among the items matching filters
+QMap<QString, int> FacetIndex::counts(Facet facet, const QVector<FacetFilter>& filters) const {
+    if (filters.isEmpty()) return counts(facet);
+    const QSet<Item*> matches = matching(filters);
+    QMap<QString, int> result;
+    const QHash<QString, Postings>& facetPostings = postings[static_cast<int>(facet)];
+    for (auto it = facetPostings.constBegin(); it != facetPostings.constEnd(); ++it) {
+        // Probe whichever side is smaller
+        const Postings& small = it.value().size() < matches.size() ? it.value() : matches;
+        const Postings& large = it.value().size() < matches.size() ? matches : it.value();
+        int count = 0;
+        for (Item* item : small) {
+            if (large.contains(item)) ++count;
+        }
+        if (count > 0) result.insert(it.key(), count);
+    }
+    return result;
+}
+
+// Items matching every filter, in no particular order
+QVector<Item*> FacetIndex::filter(const QVector<FacetFilter>& filters) const {
+    const QSet<Item*> matches = matching(filters);
+    QVector<Item*> result;
+    result.reserve(matches.size());
+    for (Item* item : matches) {
+        result.append(item);
+    }
+    return result;
+}
+
+// Returns the value an item is indexed under for a facet, or an empty string if the facet does not apply
+QString FacetIndex::facetValue(const Item* item, Facet facet) {
+    switch (facet) {
+        case Facet::Format:
+            return item->format;
+        case Facet::Condition:
+            switch (item->condition) {
+                case ItemCondition::New: return "New";
+                case ItemCondition::Standard: return "Standard";
+                case ItemCondition::Worn: return "Worn";
+            }
+            break;
+        case Facet::Status:
+            return statusValue(item->status);
+        case Facet::Decade:
+            return QString("%1s").arg(item->publicationYear - item->publicationYear % 10);
+        case Facet::Platform:
+            if (item->type == ItemType::VideoGame) return static_cast<const VideoGame*>(item)->platform;
+            break;
+        case Facet::Genre:
+            if (item->type == ItemType::Movie) return static_cast<const Movie*>(item)->genre;
+            if (item->type == ItemType::VideoGame) return static_cast<const VideoGame*>(item)->genre;
+            break;
+    }
+    return QString();
+}
+
+QString FacetIndex::statusValue(ItemStatus status) {
+    switch (status) {
+        case ItemStatus::Available: return "Available";
+        case ItemStatus::CheckedOut: return "CheckedOut";
+        case ItemStatus::OnHold: return "OnHold";
+    }
+    return QString();
+}
+
+// Intersects the filtered facets without materializing their unions. An item has one value per facet, so the
+// alternatives of a facet are disjoint: the facet with the fewest postings drives the scan, and each of its items is
+// kept if some alternative of every other facet contains it
+QSet<Item*> FacetIndex::matching(const QVector<FacetFilter>& filters) const {
+    QVector<const Postings*> alternatives[FacetCount];
+    bool filtered[FacetCount] = {};
+    int sizes[FacetCount] = {};
+    for (const FacetFilter& f : filters) {
+        const int facet = static_cast<int>(f.facet);
+        filtered[facet] = true;
+        auto it = postings[facet].constFind(f.value);
+        if (it == postings[facet].constEnd() || alternatives[facet].contains(&it.value())) continue;
+        alternatives[facet].append(&it.value());
+        sizes[facet] += it.value().size();
+    }
+    QVector<int> facets;
+    for (int f = 0; f < FacetCount; ++f) {
+        if (filtered[f]) facets.append(f);
+    }
+    QSet<Item*> result;
+    if (facets.isEmpty()) return result;
+    std::sort(facets.begin(), facets.end(), [&sizes](int a, int b) { return sizes[a] < sizes[b]; });
+
+    result.reserve(sizes[facets.first()]);
+    for (const Postings* driver : alternatives[facets.first()]) {
+        for (Item* item : *driver) {
+            bool matches = true;
+            for (int i = 1; matches && i < facets.size(); ++i) {
+                matches = false;
+                for (const Postings* candidate : alternatives[facets[i]]) {
+                    if (candidate->contains(item)) {
+                        matches = true;
+                        break;
+                    }
+                }
+            }
+            if (matches) result.insert(item);
+        }
+    }
+    return result;
+}
+
+// Posting list of a facet value, or null if there is none and create is false. Checks the facet's last value by
+// pointer before falling back to a hash lookup
+FacetIndex::Postings* FacetIndex::findPostings(Facet facet, const QString& value, bool create) {
+    const int f = static_cast<int>(facet);
+    if (lastPostings[f] && StringPool::sameInterned(value, lastValue[f])) return lastPostings[f];
+    QHash<QString, Postings>& facetPostings = postings[f];
+    auto it = facetPostings.find(value);
+    if (it == facetPostings.end()) {
+        if (!create) return nullptr;
+        it = facetPostings.insert(value, Postings());
+    }
+    lastValue[f] = value;
+    lastPostings[f] = &it.value();
+    return lastPostings[f];
+}
+
+void FacetIndex::addPosting(Facet facet, const QString& value, Item* item) {
+    if (value.isEmpty()) return;
+    findPostings(facet, value, true)->insert(item);
+}
+
+void FacetIndex::removePosting(Facet facet, const QString& value, Item* item) {
+    if (value.isEmpty()) return;
+    Postings* itemPostings = findPostings(facet, value, false);
+    if (!itemPostings) return;
+    itemPostings->remove(item);
+    if (!itemPostings->isEmpty()) return;
+    const int f = static_cast<int>(facet);
+    postings[f].remove(value);
+    lastValue[f].clear();
+    lastPostings[f] = nullptr;
+}
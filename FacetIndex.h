@@ -0,0 +1,59 @@
+#ifndef FACETINDEX_H
+#define FACETINDEX_H
+
+#include "Item.h"
+#include <QHash>
+#include <QMap>
+#include <QSet>
+#include <QString>
+#include <QVector>
+
+enum class Facet {
+    Format,
+    Condition,
+    Status,
+    Decade,
+    Platform,
+    Genre
+};
+
+const int FacetCount = 6;
+
+struct FacetFilter {
+    Facet facet;
+    QString value;
+};
+
+// Posting lists of catalogue items per facet value. Filters on the same facet are alternatives (OR); filters on
+// different facets must all hold (AND). Items without a value for a facet (a book has no platform) are not listed
+// under that facet
+class FacetIndex {
+public:
+    void addItem(Item* item);
+    void removeItem(Item* item);
+    void updateStatus(Item* item, ItemStatus previousStatus);
+    void clear();
+
+    QMap<QString, int> counts(Facet facet) const;
+    QMap<QString, int> counts(Facet facet, const QVector<FacetFilter>& filters) const;
+    QVector<Item*> filter(const QVector<FacetFilter>& filters) const;
+
+    static QString facetValue(const Item* item, Facet facet);
+    static QString statusValue(ItemStatus status);
+
+private:
+    typedef QSet<Item*> Postings;
+
+    QSet<Item*> matching(const QVector<FacetFilter>& filters) const;
+    Postings* findPostings(Facet facet, const QString& value, bool create);
+    void addPosting(Facet facet, const QString& value, Item* item);
+    void removePosting(Facet facet, const QString& value, Item* item);
+
+    QHash<QString, Postings> postings[FacetCount];
+    // Key and posting list of the last value looked up per facet. Consecutive items mostly share interned
+    // attribute values, which then match by pointer without hashing the key
+    QString lastValue[FacetCount];
+    Postings* lastPostings[FacetCount] = {};
+};
+
+#endif // FACETINDEX_H
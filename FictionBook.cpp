@@ -6,10 +6,14 @@ FictionBook::FictionBook(const QString& title,
                          const QString& format,
                          ItemCondition condition,
                          const QString& isbnNum)
-    : Item(title, author, year, format, condition), isbn(isbnNum)
+    : Item(ItemType::Fiction, title, author, year, format, condition), isbn(isbnNum)
 {
 }
 
 QString FictionBook::typeName() const {
     return "Fiction";
 }
+
+Item* FictionBook::clone() const {
+    return new FictionBook(*this);
+}
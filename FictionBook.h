@@ -15,6 +15,7 @@ public:
                 const QString& isbnNum);
 
     QString typeName() const override;
+    Item* clone() const override;
 };
 
 #endif // FICTIONBOOK_H
@@ -0,0 +1,99 @@
+#include "FinesEngine.h"
+#include <QElapsedTimer>
+#include <QSet>
+#include <QDebug>
+
+FinesEngine::FinesEngine(UserService* userService)
+    : userService(userService)
+{
+}
+
+// Charges every overdue loan up to asOf. Loans are read through idx_loans_accrual in keyset batches of BatchSize, and
+// each batch's fines and watermarks are written in one unit of work. Patrons already in memory are updated in place
+FinesEngine::PassStats FinesEngine::runNightlyPass(const QDate& asOf) {
+    PassStats stats{0, 0, 0.0, 0};
+    if (lastNightlyPass.isValid() && asOf <= lastNightlyPass) return stats;
+    QElapsedTimer timer;
+    timer.start();
+
+    DatabaseManager& db = DatabaseManager::instance();
+    // Watermarks still queued for write-behind must be visible before loans are read
+    db.flushWrites();
+    QSet<QString> patrons;
+    QDate afterAccrued;
+    QDate afterDue;
+    qint64 afterRowId = 0;
+    for (;;) {
+        const QVector<DatabaseManager::OverdueLoan> loans =
+            db.loadOverdueLoans(asOf, afterAccrued, afterDue, afterRowId, BatchSize);
+        if (loans.isEmpty()) break;
+        QHash<QString, double> finesByPatron;
+        if (!applyAccruals(loans, asOf, finesByPatron)) {
+            qWarning() << "Fines pass for" << asOf << "stopped after" << stats.loans << "loans";
+            stats.elapsedMs = timer.elapsed();
+            return stats;
+        }
+        for (auto it = finesByPatron.constBegin(); it != finesByPatron.constEnd(); ++it) {
+            if (Patron* patron = userService->loadedPatron(it.key())) patron->outstandingFines += it.value();
+            patrons.insert(it.key());
+            stats.amount += it.value();
+        }
+        stats.loans += loans.size();
+        afterAccrued = loans.last().accruedThrough;
+        afterDue = loans.last().dueDate;
+        afterRowId = loans.last().rowId;
+        if (loans.size() < BatchSize) break;
+    }
+    lastNightlyPass = asOf;
+    stats.patrons = patrons.size();
+    stats.elapsedMs = timer.elapsed();
+    return stats;
+}
+
+// Charges the patron's overdue loans up to asOf and returns the amount added to their fines
+double FinesEngine::accrueForPatron(Patron* patron, const QDate& asOf) {
+    if (!patron) return 0.0;
+    DatabaseManager& db = DatabaseManager::instance();
+    db.flushWrites();
+    const QVector<DatabaseManager::OverdueLoan> loans = db.loadOverdueLoansForPatron(patron->name, asOf);
+    if (loans.isEmpty()) return 0.0;
+    QHash<QString, double> finesByPatron;
+    if (!applyAccruals(loans, asOf, finesByPatron)) return 0.0;
+    const double amount = finesByPatron.value(patron->name, 0.0);
+    patron->outstandingFines += amount;
+    return amount;
+}
+
+// Fine owed for the days after both the due date and the last accrual, up to and including asOf
+double FinesEngine::fineFor(const QDate& dueDate, const QDate& accruedThrough, const QDate& asOf) {
+    if (!dueDate.isValid() || !asOf.isValid()) return 0.0;
+    const QDate from = accruedThrough.isValid() && accruedThrough > dueDate ? accruedThrough : dueDate;
+    const qint64 days = from.daysTo(asOf);
+    return days > 0 ? days * DailyFine : 0.0;
+}
+
+// Adds each loan's fine to its patron and moves its watermark to asOf, all in one unit of work. finesByPatron
+// receives the total charged per patron
+bool FinesEngine::applyAccruals(const QVector<DatabaseManager::OverdueLoan>& loans, const QDate& asOf,
+                                QHash<QString, double>& finesByPatron) {
+    for (const DatabaseManager::OverdueLoan& loan : loans) {
+        const double fine = fineFor(loan.dueDate, loan.accruedThrough, asOf);
+        if (fine > 0.0) finesByPatron[loan.patronName] += fine;
+    }
+
+    DatabaseManager& db = DatabaseManager::instance();
+    bool ok = db.beginUnitOfWork();
+    for (auto it = finesByPatron.constBegin(); ok && it != finesByPatron.constEnd(); ++it) {
+        ok = db.addPatronFine(it.key(), it.value());
+    }
+    for (int i = 0; ok && i < loans.size(); ++i) {
+        ok = db.markLoanAccrued(loans[i].patronName, loans[i].itemId, asOf);
+    }
+    if (!ok) db.rollbackUnitOfWork();
+    // Fines are money and the caller adds them to patrons in memory next, so wait for the write to be durable
+    if (!ok || !db.commitUnitOfWork() || !db.waitForUnitOfWork(db.lastUnitOfWorkTicket())) {
+        finesByPatron.clear();
+        return false;
+    }
+    return true;
+}
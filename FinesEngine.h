@@ -0,0 +1,46 @@
+#ifndef FINESENGINE_H
+#define FINESENGINE_H
+
+#include "User.h"
+#include "UserService.h"
+#include "DatabaseManager.h"
+#include <QDate>
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+// Charged per loan for each day past its due date
+const double DailyFine = 0.25;
+
+// Accrues overdue fines from Loans.dueDate. Each loan keeps an accruedThrough watermark that moves forward with
+// every charge in the same transaction, so running a pass twice for the same day charges nothing the second time.
+// The nightly pass walks overdue loans in batches by due date; accrueForPatron() brings one patron up to date on
+// demand, e.g. at login or before a return
+class FinesEngine {
+public:
+    struct PassStats {
+        int loans;
+        int patrons;
+        double amount;
+        qint64 elapsedMs;
+    };
+
+    explicit FinesEngine(UserService* userService);
+
+    PassStats runNightlyPass(const QDate& asOf = QDate::currentDate());
+    double accrueForPatron(Patron* patron, const QDate& asOf = QDate::currentDate());
+
+    static double fineFor(const QDate& dueDate, const QDate& accruedThrough, const QDate& asOf);
+
+private:
+    static const int BatchSize = 5000;
+
+    bool applyAccruals(const QVector<DatabaseManager::OverdueLoan>& loans, const QDate& asOf,
+                       QHash<QString, double>& finesByPatron);
+
+    UserService* userService;
+    // Day of the last completed nightly pass; later calls for the same day return at once
+    QDate lastNightlyPass;
+};
+
+#endif // FINESENGINE_H
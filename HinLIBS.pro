@@ -19,6 +19,18 @@ SOURCES += \
     LoanService.cpp \
     HoldService.cpp \
     DatabaseManager.cpp \
+    PersistenceWorker.cpp \
+    CatalogueImporter.cpp \
+    ItemArena.cpp \
+    StringPool.cpp \
+    SearchIndex.cpp \
+    ItemCache.cpp \
+    FacetIndex.cpp \
+    Isbn.cpp \
+    CatalogueSnapshot.cpp \
+    PatronRegistry.cpp \
+    HoldQueue.cpp \
+    FinesEngine.cpp \
     ReturnOnBehalfDialog.cpp
 
 
@@ -36,6 +48,18 @@ HEADERS += \
     LoanService.h \
     HoldService.h \
     DatabaseManager.h \
+    PersistenceWorker.h \
+    CatalogueImporter.h \
+    ItemArena.h \
+    StringPool.h \
+    SearchIndex.h \
+    ItemCache.h \
+    FacetIndex.h \
+    Isbn.h \
+    CatalogueSnapshot.h \
+    PatronRegistry.h \
+    HoldQueue.h \
+    FinesEngine.h \
     ReturnOnBehalfDialog.h
 
 FORMS += \
@@ -0,0 +1,185 @@
+#include "HoldQueue.h"
+#include <QReadWriteLock>
+
+namespace {
+
+struct PatronIdTable {
+    QReadWriteLock lock;
+    QHash<QString, quint32> ids;
+    // Names by id; index 0 is the unused "no patron" id
+    QVector<QString> names{QString()};
+};
+
+PatronIdTable& patronIdTable() {
+    static PatronIdTable table;
+    return table;
+}
+
+}
+
+// Returns the id for name, assigning the next free one on first sight
+quint32 PatronIds::idFor(const QString& name) {
+    quint32 id = find(name);
+    if (id) return id;
+    PatronIdTable& table = patronIdTable();
+    QWriteLocker locker(&table.lock);
+    auto it = table.ids.constFind(name);
+    if (it != table.ids.constEnd()) return it.value();
+    id = quint32(table.names.size());
+    table.names.append(name);
+    table.ids.insert(name, id);
+    return id;
+}
+
+// Returns the id for name, or 0 if it has never been queued
+quint32 PatronIds::find(const QString& name) {
+    PatronIdTable& table = patronIdTable();
+    QReadLocker locker(&table.lock);
+    return table.ids.value(name, 0);
+}
+
+QString PatronIds::nameOf(quint32 id) {
+    PatronIdTable& table = patronIdTable();
+    QReadLocker locker(&table.lock);
+    return id < quint32(table.names.size()) ? table.names[int(id)] : QString();
+}
+
+HoldQueue::HoldQueue()
+    : headSeq(0),
+      tailSeq(0),
+      live(0),
+      cancelled(0)
+{
+}
+
+QString HoldQueue::front() const {
+    return live ? PatronIds::nameOf(ring[slotOf(headSeq)]) : QString();
+}
+
+bool HoldQueue::isFront(const QString& patronName) const {
+    return live && ring[slotOf(headSeq)] == PatronIds::find(patronName);
+}
+
+bool HoldQueue::contains(const QString& patronName) const {
+    return seqById.contains(PatronIds::find(patronName));
+}
+
+// Returns the patron's 1-based place in the queue, or -1 if they are not waiting
+int HoldQueue::position(const QString& patronName) const {
+    auto it = seqById.constFind(PatronIds::find(patronName));
+    if (it == seqById.constEnd()) return -1;
+    const qint64 seq = it.value();
+    const int ahead = int(seq - headSeq) - (cancelled ? cancelledBetween(headSeq, seq) : 0);
+    return ahead + 1;
+}
+
+// Adds the patron to the back of the queue. Returns false if they are already waiting
+bool HoldQueue::enqueue(const QString& patronName) {
+    const quint32 id = PatronIds::idFor(patronName);
+    if (seqById.contains(id)) return false;
+    if (tailSeq - headSeq == ring.size()) {
+        int capacity = 4;
+        while (capacity < 2 * (live + 1)) capacity *= 2;
+        compact(capacity);
+    }
+    ring[slotOf(tailSeq)] = id;
+    seqById.insert(id, tailSeq++);
+    ++live;
+    return true;
+}
+
+// Removes and returns the patron at the front, or an empty string if nobody is waiting
+QString HoldQueue::dequeue() {
+    if (!live) return QString();
+    const quint32 id = ring[slotOf(headSeq)];
+    seqById.remove(id);
+    ++headSeq;
+    --live;
+    skipCancelled();
+    if (!live) clear();
+    return PatronIds::nameOf(id);
+}
+
+// Cancels the patron's place in the queue. Returns false if they were not waiting
+bool HoldQueue::remove(const QString& patronName) {
+    auto it = seqById.find(PatronIds::find(patronName));
+    if (it == seqById.end()) return false;
+    const qint64 seq = it.value();
+    seqById.erase(it);
+    --live;
+    if (!live) {
+        clear();
+        return true;
+    }
+    ring[slotOf(seq)] = 0;
+    if (seq == headSeq) {
+        ++headSeq;
+        skipCancelled();
+    } else {
+        addCancelled(slotOf(seq), 1);
+        ++cancelled;
+        if (cancelled > live) compact(ring.size());
+    }
+    return true;
+}
+
+void HoldQueue::clear() {
+    ring.clear();
+    cancelledTree.clear();
+    seqById.clear();
+    headSeq = 0;
+    tailSeq = 0;
+    live = 0;
+    cancelled = 0;
+}
+
+// Moves the live entries to the start of a new ring of the given power-of-two capacity, dropping tombstones
+void HoldQueue::compact(int capacity) {
+    QVector<quint32> packed(capacity, 0);
+    int count = 0;
+    for (qint64 seq = headSeq; seq < tailSeq; ++seq) {
+        const quint32 id = ring[slotOf(seq)];
+        if (!id) continue;
+        packed[count] = id;
+        seqById[id] = count;
+        ++count;
+    }
+    ring = packed;
+    cancelledTree = QVector<int>(capacity + 1, 0);
+    headSeq = 0;
+    tailSeq = count;
+    cancelled = 0;
+}
+
+// Advances the head past cancelled entries so the front slot always holds a waiting patron
+void HoldQueue::skipCancelled() {
+    while (headSeq < tailSeq && ring[slotOf(headSeq)] == 0) {
+        addCancelled(slotOf(headSeq), -1);
+        --cancelled;
+        ++headSeq;
+    }
+}
+
+void HoldQueue::addCancelled(int slot, int delta) {
+    for (int i = slot + 1; i < cancelledTree.size(); i += i & -i) {
+        cancelledTree[i] += delta;
+    }
+}
+
+// Number of cancelled entries in slots [0, slot)
+int HoldQueue::cancelledBefore(int slot) const {
+    int total = 0;
+    for (int i = slot; i > 0; i -= i & -i) {
+        total += cancelledTree[i];
+    }
+    return total;
+}
+
+// Number of cancelled entries with sequence numbers in [fromSeq, toSeq), accounting for wrap-around in the ring
+int HoldQueue::cancelledBetween(qint64 fromSeq, qint64 toSeq) const {
+    if (toSeq <= fromSeq) return 0;
+    const int from = slotOf(fromSeq);
+    const int to = slotOf(toSeq);
+    if (from < to) return cancelledBefore(to) - cancelledBefore(from);
+    return cancelledBefore(ring.size()) - cancelledBefore(from) + cancelledBefore(to);
+}
@@ -0,0 +1,58 @@
+#ifndef HOLDQUEUE_H
+#define HOLDQUEUE_H
+
+#include <QString>
+#include <QVector>
+#include <QHash>
+
+// Process-wide mapping between patron names and compact ids, so hold queues store 4 bytes per entry instead of a
+// string. Ids start at 1 and are never reused; 0 means "no patron". Safe to read from snapshot reader threads
+class PatronIds {
+public:
+    static quint32 idFor(const QString& name);
+    static quint32 find(const QString& name);
+    static QString nameOf(quint32 id);
+};
+
+// FIFO of patrons waiting for an item. Entries live in a power-of-two ring buffer indexed by a monotonic sequence
+// number, with a hash from patron id to sequence number beside it. Enqueue, dequeue, membership and front checks
+// are O(1). Cancelling from the middle leaves a tombstone counted in a Fenwick tree over the ring slots, so
+// cancel is O(log n), and position() is O(1) while no tombstones are waiting ahead and O(log n) otherwise.
+// Tombstones are compacted away once they outnumber live entries
+class HoldQueue {
+public:
+    HoldQueue();
+
+    bool isEmpty() const { return live == 0; }
+    int size() const { return live; }
+
+    QString front() const;
+    bool isFront(const QString& patronName) const;
+    bool contains(const QString& patronName) const;
+    int position(const QString& patronName) const;
+
+    bool enqueue(const QString& patronName);
+    QString dequeue();
+    bool remove(const QString& patronName);
+    void clear();
+
+private:
+    int slotOf(qint64 seq) const { return int(seq & (ring.size() - 1)); }
+    void compact(int capacity);
+    void skipCancelled();
+    void addCancelled(int slot, int delta);
+    int cancelledBefore(int slot) const;
+    int cancelledBetween(qint64 fromSeq, qint64 toSeq) const;
+
+    // Patron ids by slot; 0 marks a cancelled entry. Size is zero or a power of two
+    QVector<quint32> ring;
+    // Fenwick tree over ring slots counting cancelled entries, 1-based
+    QVector<int> cancelledTree;
+    QHash<quint32, qint64> seqById;
+    qint64 headSeq;
+    qint64 tailSeq;
+    int live;
+    int cancelled;
+};
+
+#endif // HOLDQUEUE_H
@@ -2,8 +2,8 @@
 #include "DatabaseManager.h"
 #include <algorithm>
 
-HoldService::HoldService(LibraryService* libService, LoanService* loanService)
-    : libraryService(libService), loanService(loanService)
+HoldService::HoldService(LibraryService* libService, LoanService* loanService, UserService* userService)
+    : libraryService(libService), loanService(loanService), userService(userService)
 {
 }
 
@@ -30,13 +30,28 @@ ActionResult HoldService::placeHold(Patron* patron, const QUuid& itemId) {
         return {false, "You already have a hold on this item."};
     }
 
-    item->holdQueue.push_back(patron->name);
+    const QString patronName = patron->name;
+    const HoldQueue previousQueue = item->holdQueue;
+    const QVector<QUuid> previousHolds = patron->activeHolds;
+
+    item->holdQueue.enqueue(patron->name);
     patron->activeHolds.push_back(itemId);
 
-    DatabaseManager::instance().saveHold(patron->name, itemId.toString(), item->holdQueue.size() - 1);
-    DatabaseManager::instance().updateItem(item);
+    DatabaseManager& db = DatabaseManager::instance();
+    bool ok = db.beginUnitOfWork();
+    ok = ok && db.appendHold(patron->name, itemId);
+    ok = ok && db.updateItem(item);
+    if (!ok) db.rollbackUnitOfWork();
+    const auto rollback = [this, itemId, previousQueue, patronName, previousHolds]() {
+        restoreHold(itemId, previousQueue, patronName, previousHolds);
+    };
+    if (!ok || !db.commitUnitOfWork(rollback)) {
+        rollback();
+        return {false, "Could not save the hold. Please try again."};
+    }
+    libraryService->markItemChanged(item);
 
-    int position = item->holdQueue.size();
+    int position = item->holdQueue.position(patron->name);
     QString msg = QString("Hold placed successfully. You are #%1 in the queue.").arg(position);
 
     return {true, msg};
@@ -58,19 +73,40 @@ ActionResult HoldService::cancelHold(Patron* patron, const QUuid& itemId) {
         return {false, "You do not have a hold on this item."};
     }
 
-    patron->activeHolds.erase(holdIt);
+    const QString patronName = patron->name;
+    const QVector<QUuid> previousHolds = patron->activeHolds;
+    const HoldQueue previousQueue = item->holdQueue;
 
-    auto qIt = std::find(item->holdQueue.begin(), item->holdQueue.end(), patron->name);
-    if (qIt != item->holdQueue.end()) {
-        item->holdQueue.erase(qIt);
+    patron->activeHolds.erase(holdIt);
+    item->holdQueue.remove(patron->name);
+
+    DatabaseManager& db = DatabaseManager::instance();
+    bool ok = db.beginUnitOfWork();
+    ok = ok && db.deleteHold(patron->name, itemId);
+    if (!ok) db.rollbackUnitOfWork();
+    const auto rollback = [this, itemId, previousQueue, patronName, previousHolds]() {
+        restoreHold(itemId, previousQueue, patronName, previousHolds);
+    };
+    if (!ok || !db.commitUnitOfWork(rollback)) {
+        rollback();
+        return {false, "Could not cancel the hold. Please try again."};
     }
-
-    DatabaseManager::instance().deleteHold(patron->name, itemId.toString());
-    DatabaseManager::instance().updateHoldPositions(itemId.toString(), item->holdQueue);
+    libraryService->markItemChanged(item);
 
     return {true, "Hold canceled successfully."};
 }
 
+// Puts back an item's queue and the patron's holds after a hold change did not commit. Both are looked up again,
+// since the write-behind worker may report the rollback after the pointers used for the change are gone
+void HoldService::restoreHold(const QUuid& itemId, const HoldQueue& queue, const QString& patronName,
+                              const QVector<QUuid>& activeHolds) {
+    if (Item* item = libraryService->findItemById(itemId)) {
+        item->holdQueue = queue;
+        libraryService->markItemChanged(item);
+    }
+    if (Patron* patron = userService->loadedPatron(patronName)) patron->activeHolds = activeHolds;
+}
+
 // Checks if a patron already has an active hold on the specified item
 bool HoldService::patronHasHold(const Patron& patron, const QUuid& itemId) const {
     return std::any_of(patron.activeHolds.begin(), patron.activeHolds.end(),
@@ -80,11 +116,5 @@ bool HoldService::patronHasHold(const Patron& patron, const QUuid& itemId) const
 // Returns the patrons position in the hold queue for an item (1-indexed), or -1 if not in queue
 int HoldService::getQueuePosition(const Patron& patron, const Item* item) const {
     if (!item) return -1;
-
-    for (int i = 0; i < item->holdQueue.size(); ++i) {
-        if (item->holdQueue[i] == patron.name) {
-            return i + 1;
-        }
-    }
-    return -1;
+    return item->holdQueue.position(patron.name);
 }
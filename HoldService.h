@@ -5,11 +5,12 @@
 #include "Item.h"
 #include "LibraryService.h"
 #include "LoanService.h"
+#include "UserService.h"
 #include <QUuid>
 
 class HoldService {
 public:
-    HoldService(LibraryService* libService, LoanService* loanService);
+    HoldService(LibraryService* libService, LoanService* loanService, UserService* userService);
 
     // Hold operations
     ActionResult placeHold(Patron* patron, const QUuid& itemId);
@@ -20,8 +21,12 @@ public:
     int getQueuePosition(const Patron& patron, const Item* item) const;
 
 private:
+    void restoreHold(const QUuid& itemId, const HoldQueue& queue, const QString& patronName,
+                     const QVector<QUuid>& activeHolds);
+
     LibraryService* libraryService;
     LoanService* loanService;
+    UserService* userService;
 };
 
 #endif // HOLDSERVICE_H
@@ -0,0 +1,56 @@
+#include "Isbn.h"
+
+// Strips spaces and hyphens and validates the check digit. Returns the ISBN-13 digits, or an empty string if
+// text is not a valid ISBN-10 or ISBN-13
+QString Isbn::normalize(const QString& text) {
+    QString digits;
+    digits.reserve(13);
+    for (const QChar c : text) {
+        if (c == QChar('-') || c.isSpace()) continue;
+        digits.append(c.toUpper());
+    }
+    if (digits.size() == 13) {
+        return isValidIsbn13(digits) ? digits : QString();
+    }
+    if (digits.size() == 10 && isValidIsbn10(digits)) {
+        const QString first12 = "978" + digits.left(9);
+        return first12 + isbn13CheckDigit(first12);
+    }
+    return QString();
+}
+
+// Ten characters, nine digits then a digit or X, with a weighted sum divisible by 11
+bool Isbn::isValidIsbn10(const QString& digits) {
+    if (digits.size() != 10) return false;
+    int sum = 0;
+    for (int i = 0; i < 10; ++i) {
+        const QChar c = digits.at(i);
+        int value;
+        if (c.isDigit()) {
+            value = c.digitValue();
+        } else if (i == 9 && c == QChar('X')) {
+            value = 10;
+        } else {
+            return false;
+        }
+        sum += value * (10 - i);
+    }
+    return sum % 11 == 0;
+}
+
+// Thirteen digits whose last digit matches the alternating 1/3 weighted checksum
+bool Isbn::isValidIsbn13(const QString& digits) {
+    if (digits.size() != 13) return false;
+    for (const QChar c : digits) {
+        if (!c.isDigit()) return false;
+    }
+    return isbn13CheckDigit(digits.left(12)) == digits.at(12);
+}
+
+QChar Isbn::isbn13CheckDigit(const QString& first12) {
+    int sum = 0;
+    for (int i = 0; i < 12; ++i) {
+        sum += first12.at(i).digitValue() * (i % 2 == 0 ? 1 : 3);
+    }
+    return QChar('0' + (10 - sum % 10) % 10);
+}
@@ -0,0 +1,18 @@
+#ifndef ISBN_H
+#define ISBN_H
+
+#include <QString>
+
+// ISBN parsing helpers. The normalized form of an ISBN is its 13 digits with no separators; ISBN-10s are
+// converted to their 978-prefixed ISBN-13
+class Isbn {
+public:
+    static QString normalize(const QString& text);
+    static bool isValidIsbn10(const QString& digits);
+    static bool isValidIsbn13(const QString& digits);
+
+private:
+    static QChar isbn13CheckDigit(const QString& first12);
+};
+
+#endif // ISBN_H
@@ -1,11 +1,13 @@
 #include "Item.h"
 
-Item::Item(const QString& title,
+Item::Item(ItemType type,
+           const QString& title,
            const QString& creator,
            int year,
            const QString& format,
            ItemCondition condition)
-    : itemId(QUuid::createUuid()),
+    : type(type),
+      itemId(QUuid::createUuid()),
       title(title),
       creator(creator),
       publicationYear(year),
@@ -21,7 +23,7 @@ Item::~Item() {
 // Returns the item's effective status for a specific patron which shows Available if they are first in the hold queue
 ItemStatus Item::getStatusForPatron(const QString& patronName) const {
     if (status == ItemStatus::OnHold) {
-        if (!holdQueue.isEmpty() && holdQueue.first() == patronName) {
+        if (holdQueue.isFront(patronName)) {
             return ItemStatus::Available;
         }
     }
@@ -5,21 +5,36 @@
 #include <QUuid>
 #include <QDate>
 #include <QVector>
+#include "HoldQueue.h"
 
+// Enum values are stored in the database; append new values, never renumber
 enum class ItemCondition {
-    New,
-    Standard,
-    Worn
+    New = 0,
+    Standard = 1,
+    Worn = 2
 };
 
 enum class ItemStatus {
-    Available,
-    CheckedOut,
-    OnHold
+    Available = 0,
+    CheckedOut = 1,
+    OnHold = 2
 };
 
+// Concrete item kind, fixed at construction so callers can branch without dynamic_cast or typeName().
+// Stored in the database like the enums above
+enum class ItemType {
+    Fiction = 0,
+    NonFiction = 1,
+    Magazine = 2,
+    Movie = 3,
+    VideoGame = 4
+};
+
+const int ItemTypeCount = 5;
+
 class Item {
 public:
+    const ItemType type;
     QUuid itemId;
     QString title;
     QString creator;
@@ -28,9 +43,10 @@ public:
     ItemCondition condition;
     ItemStatus status;
     QDate dueDate;
-    QVector<QString> holdQueue;
+    HoldQueue holdQueue;
 
-    explicit Item(const QString& title,
+    explicit Item(ItemType type,
+                  const QString& title,
                   const QString& creator,
                   int year,
                   const QString& format,
@@ -38,6 +54,8 @@ public:
 
     virtual ~Item();
     virtual QString typeName() const = 0;
+    // Deep copy with the same itemId, used to publish immutable catalogue snapshots
+    virtual Item* clone() const = 0;
 
     ItemStatus getStatusForPatron(const QString& patronName) const;
 };
@@ -0,0 +1,78 @@
+#include "ItemArena.h"
+#include <QtGlobal>
+
+ItemArena::ItemArena(std::size_t blockSize)
+    : blockSize(qMax<std::size_t>(blockSize, 4096)),
+      reservedBytes(0)
+{
+}
+
+ItemArena::~ItemArena() {
+    release();
+}
+
+// Makes the next block at least this large, so a load of known size fits in a single allocation
+void ItemArena::reserve(std::size_t bytes) {
+    reservedBytes = qMax(reservedBytes, bytes);
+}
+
+// True if the item was constructed in this arena and has not been released yet
+bool ItemArena::owns(const Item* item) const {
+    const char* address = reinterpret_cast<const char*>(item);
+    for (const Block& block : blocks) {
+        if (address >= block.data && address < block.data + block.used) return true;
+    }
+    return false;
+}
+
+// Runs an item's destructor in place. Its memory is reclaimed by the next release(). The item must have been
+// created by this arena
+void ItemArena::destroy(Item* item) {
+    if (!item) return;
+    // A destroyed item's slot now holds another item or lies past the end, so a second destroy is ignored
+    const int slot = liveIndex(item);
+    if (slot < 0 || slot >= live.size() || live[slot] != item) return;
+    Item* moved = live.last();
+    live[slot] = moved;
+    live.removeLast();
+    liveIndex(moved) = slot;
+    item->~Item();
+}
+
+// Destroys every live item and frees all blocks in one pass
+void ItemArena::release() {
+    for (Item* item : live) {
+        item->~Item();
+    }
+    live.clear();
+    for (const Block& block : blocks) {
+        ::operator delete(block.data);
+    }
+    blocks.clear();
+    reservedBytes = 0;
+}
+
+int ItemArena::itemCount() const {
+    return live.size();
+}
+
+// Bump-allocates from the current block, starting a new block when it runs out
+void* ItemArena::allocate(std::size_t size, std::size_t alignment) {
+    if (!blocks.isEmpty()) {
+        Block& block = blocks.last();
+        std::size_t offset = (block.used + alignment - 1) & ~(alignment - 1);
+        if (offset + size <= block.size) {
+            block.used = offset + size;
+            return block.data + offset;
+        }
+    }
+    std::size_t capacity = qMax(qMax(blockSize, reservedBytes), size + alignment);
+    reservedBytes = 0;
+    Block block;
+    // operator new returns memory aligned for any fundamental type, which covers every Item subclass
+    block.data = static_cast<char*>(::operator new(capacity));
+    block.size = capacity;
+    block.used = size;
+    blocks.append(block);
+    return block.data;
+}
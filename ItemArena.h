@@ -0,0 +1,81 @@
+#ifndef ITEMARENA_H
+#define ITEMARENA_H
+
+#include "Item.h"
+#include <QVector>
+#include <QtGlobal>
+#include <cstddef>
+#include <new>
+#include <utility>
+
+// Slab allocator for catalogue items. Items are constructed in large blocks with placement new and released
+// together, so loading a catalogue costs a handful of allocations instead of one per item.
+// Item pointers stay valid until release(); items cannot be freed individually, only destroyed in place.
+// Each item is preceded in its block by a slot header holding its index in the live list, so destroy() needs no
+// search and no per-item bookkeeping outside the blocks.
+class ItemArena {
+public:
+    explicit ItemArena(std::size_t blockSize = 256 * 1024);
+    ~ItemArena();
+
+    // Constructs a T inside the arena
+    template<typename T, typename... Args>
+    T* create(Args&&... args) {
+        const std::size_t header = slotHeaderSize(alignof(T));
+        char* memory = static_cast<char*>(allocate(header + sizeof(T), alignof(T)));
+        T* item = new (memory + header) T(std::forward<Args>(args)...);
+        // The slot header sits right before the Item subobject, so it must start the object
+        Q_ASSERT(static_cast<void*>(static_cast<Item*>(item)) == static_cast<void*>(memory + header));
+        liveIndex(item) = live.size();
+        live.append(item);
+        return item;
+    }
+
+    // Bytes one T takes in a block, slot header included, for sizing reserve()
+    template<typename T>
+    static std::size_t footprint() {
+        return slotHeaderSize(alignof(T)) + sizeof(T);
+    }
+
+    void reserve(std::size_t bytes);
+    bool owns(const Item* item) const;
+    void destroy(Item* item);
+    void release();
+
+    int itemCount() const;
+
+private:
+    ItemArena(const ItemArena&) = delete;
+    ItemArena& operator=(const ItemArena&) = delete;
+
+    struct Block {
+        char* data;
+        std::size_t size;
+        std::size_t used;
+    };
+
+    void* allocate(std::size_t size, std::size_t alignment);
+
+    // Bytes reserved before an item for its slot header, keeping the item itself aligned
+    static std::size_t slotHeaderSize(std::size_t alignment) {
+        return (sizeof(int) + alignment - 1) & ~(alignment - 1);
+    }
+
+    static int& liveIndex(Item* item) {
+        return *reinterpret_cast<int*>(reinterpret_cast<char*>(item) - sizeof(int));
+    }
+
+    std::size_t blockSize;
+    std::size_t reservedBytes;
+    QVector<Block> blocks;
+    QVector<Item*> live;
+};
+
+// Constructs a T in the arena when one is given, otherwise on the heap
+template<typename T, typename... Args>
+T* createItem(ItemArena* arena, Args&&... args) {
+    if (arena) return arena->create<T>(std::forward<Args>(args)...);
+    return new T(std::forward<Args>(args)...);
+}
+
+#endif // ITEMARENA_H
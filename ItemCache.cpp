@@ -0,0 +1,129 @@
+#include "ItemCache.h"
+#include <QtGlobal>
+
+ItemCache::ItemCache(int capacity)
+    : maxItems(qMax(1, capacity)),
+      pinnedEntries(0),
+      counters{0, 0, 0}
+{
+}
+
+ItemCache::~ItemCache() {
+    clear();
+}
+
+// Returns the cached item and marks it most recently used, or nullptr on a miss
+Item* ItemCache::find(const QUuid& id) {
+    auto it = entries.find(id);
+    if (it == entries.end()) {
+        ++counters.misses;
+        return nullptr;
+    }
+    ++counters.hits;
+    recency.splice(recency.begin(), recency, it.value().position);
+    return it.value().item;
+}
+
+// Returns the cached item without counting a lookup or changing its recency, or nullptr if it is not cached
+Item* ItemCache::peek(const QUuid& id) const {
+    auto it = entries.constFind(id);
+    return it == entries.constEnd() ? nullptr : it.value().item;
+}
+
+// Takes ownership of item, replacing any cached item with the same id, then evicts down to capacity
+void ItemCache::insert(Item* item) {
+    if (!item) return;
+    auto it = entries.find(item->itemId);
+    if (it != entries.end()) {
+        if (it.value().item != item) delete it.value().item;
+        it.value().item = item;
+        recency.splice(recency.begin(), recency, it.value().position);
+    } else {
+        recency.push_front(item->itemId);
+        entries.insert(item->itemId, Entry{item, 0, recency.begin()});
+    }
+    evictOverflow(item);
+}
+
+// Removes an item from the cache without deleting it; the caller takes ownership
+Item* ItemCache::take(const QUuid& id) {
+    auto it = entries.find(id);
+    if (it == entries.end()) return nullptr;
+    Item* item = it.value().item;
+    if (it.value().pins > 0) --pinnedEntries;
+    recency.erase(it.value().position);
+    entries.erase(it);
+    return item;
+}
+
+bool ItemCache::remove(const QUuid& id) {
+    Item* item = take(id);
+    delete item;
+    return item != nullptr;
+}
+
+void ItemCache::clear() {
+    for (const Entry& entry : entries) {
+        delete entry.item;
+    }
+    entries.clear();
+    recency.clear();
+    pinnedEntries = 0;
+}
+
+// Keeps an item resident until a matching unpin(), for callers that hold its pointer across other lookups
+void ItemCache::pin(const QUuid& id) {
+    auto it = entries.find(id);
+    if (it != entries.end() && it.value().pins++ == 0) ++pinnedEntries;
+}
+
+void ItemCache::unpin(const QUuid& id) {
+    auto it = entries.find(id);
+    if (it != entries.end() && it.value().pins > 0 && --it.value().pins == 0) --pinnedEntries;
+    evictOverflow();
+}
+
+bool ItemCache::isPinned(const QUuid& id) const {
+    auto it = entries.constFind(id);
+    return it != entries.constEnd() && it.value().pins > 0;
+}
+
+bool ItemCache::hasPinnedItems() const {
+    return pinnedEntries > 0;
+}
+
+int ItemCache::size() const {
+    return entries.size();
+}
+
+int ItemCache::capacity() const {
+    return maxItems;
+}
+
+ItemCache::Stats ItemCache::stats() const {
+    return counters;
+}
+
+// Items in circulation stay resident so their in-memory state is never reloaded from a stale row
+bool ItemCache::evictable(const Entry& entry) {
+    return entry.pins == 0 && entry.item->status == ItemStatus::Available;
+}
+
+// Evicts least recently used items until the cache fits, never evicting keep. Resident items met on the way are
+// moved to the front, so each pass skips them at most once
+void ItemCache::evictOverflow(const Item* keep) {
+    int skipped = 0;
+    while (entries.size() > maxItems && skipped < entries.size()) {
+        const QUuid id = recency.back();
+        auto it = entries.find(id);
+        if (!evictable(it.value()) || it.value().item == keep) {
+            recency.splice(recency.begin(), recency, it.value().position);
+            ++skipped;
+            continue;
+        }
+        delete it.value().item;
+        recency.pop_back();
+        entries.erase(it);
+        ++counters.evictions;
+    }
+}
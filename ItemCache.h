@@ -0,0 +1,62 @@
+#ifndef ITEMCACHE_H
+#define ITEMCACHE_H
+
+#include "Item.h"
+#include <QHash>
+#include <QUuid>
+#include <QVector>
+#include <list>
+
+// Size-bounded LRU cache of heap-allocated items, keyed by itemId. The cache owns its items and deletes them
+// on eviction. Pinned items and items that are checked out or on hold are never evicted, so the cache may grow
+// past its capacity while they are resident
+class ItemCache {
+public:
+    struct Stats {
+        int hits;
+        int misses;
+        int evictions;
+    };
+
+    explicit ItemCache(int capacity);
+    ~ItemCache();
+
+    Item* find(const QUuid& id);
+    Item* peek(const QUuid& id) const;
+    void insert(Item* item);
+    Item* take(const QUuid& id);
+    bool remove(const QUuid& id);
+    void clear();
+
+    void pin(const QUuid& id);
+    void unpin(const QUuid& id);
+    bool isPinned(const QUuid& id) const;
+    bool hasPinnedItems() const;
+
+    int size() const;
+    int capacity() const;
+    Stats stats() const;
+
+private:
+    ItemCache(const ItemCache&) = delete;
+    ItemCache& operator=(const ItemCache&) = delete;
+
+    struct Entry {
+        Item* item;
+        int pins;
+        std::list<QUuid>::iterator position;
+    };
+
+    static bool evictable(const Entry& entry);
+    void evictOverflow(const Item* keep = nullptr);
+
+    int maxItems;
+    // Most recently used first
+    std::list<QUuid> recency;
+    QHash<QUuid, Entry> entries;
+    // Number of entries with at least one pin
+    int pinnedEntries;
+    Stats counters;
+};
+
+#endif // ITEMCACHE_H
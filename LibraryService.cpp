@@ -1,74 +1,387 @@
 #include "LibraryService.h"
 #include "DatabaseManager.h"
+#include "StringPool.h"
+#include "Isbn.h"
+#include <QDebug>
 
-// Initializes the library service by loading all items from the database into memory
-LibraryService::LibraryService() {
-    catalogue = DatabaseManager::instance().loadAllItems();
+// Initializes the library service. Eager mode loads all items from the database into memory; lazy mode loads
+// nothing up front
+LibraryService::LibraryService(CatalogueMode mode, int cacheCapacity)
+    : catalogueMode(mode),
+      cache(cacheCapacity),
+      snapshotsEnabled(false),
+      appliedChangeSeq(0)
+{
+    if (catalogueMode == CatalogueMode::Eager) {
+        loadFullCatalogue();
+    } else {
+        appliedChangeSeq = DatabaseManager::instance().latestChangeSeq();
+    }
 }
 
 LibraryService::~LibraryService() {
-    for (Item* item : catalogue) {
-        delete item;
-    }
-    catalogue.clear();
+    releaseCatalogue();
+    cache.clear();
 }
 
-// Searches the catalogue for an item matching the given UUID
+CatalogueMode LibraryService::mode() const {
+    return catalogueMode;
+}
+
+// Looks up an item by UUID through the id index, or through the item cache in lazy mode
 Item* LibraryService::findItemById(const QUuid& id) {
-    for (Item* it : catalogue) {
-        if (it->itemId == id) return it;
-    }
-    return nullptr;
+    return lookup(id);
 }
 
 const Item* LibraryService::findItemById(const QUuid& id) const {
-    for (Item* it : catalogue) {
-        if (it->itemId == id) return it;
+    return lookup(id);
+}
+
+// In lazy mode a miss loads the item into the cache. The pointer stays valid until the item is evicted, which
+// cannot happen while it is pinned or in circulation
+Item* LibraryService::lookup(const QUuid& id) const {
+    if (catalogueMode == CatalogueMode::Eager) {
+        auto it = itemsById.constFind(id);
+        return it == itemsById.constEnd() ? nullptr : it.value().item;
     }
-    return nullptr;
+    Item* item = cache.find(id);
+    if (item) return item;
+    DatabaseManager& db = DatabaseManager::instance();
+    // Queued write-behind batches may still hold this item's latest state
+    db.flushWrites();
+    item = db.loadItemById(id);
+    if (item) cache.insert(item);
+    return item;
 }
 
 QVector<Item*> LibraryService::getAllItems() const {
     return catalogue;
 }
 
-// Filters and returns all items of a specific type
-QVector<Item*> LibraryService::getItemsByType(const QString& typeName) const {
-    QVector<Item*> result;
-    for (Item* item : catalogue) {
-        if (item->typeName() == typeName) {
-            result.append(item);
+// Returns the partition holding every item of a specific type. The reference stays valid until the catalogue
+// changes
+const QVector<Item*>& LibraryService::getItemsByType(ItemType type) const {
+    return itemsByType[static_cast<int>(type)];
+}
+
+// Calls visit for every item of one type. Eager mode walks the type partition; lazy mode streams the Items table
+// a page at a time in id order, visiting the cached copy of any item already in the cache. An item pointer is only
+// valid during its visit
+void LibraryService::forEachItemOfType(ItemType type, const std::function<void(Item*)>& visit) {
+    if (catalogueMode == CatalogueMode::Eager) {
+        for (Item* item : itemsByType[static_cast<int>(type)]) {
+            visit(item);
+        }
+        return;
+    }
+    DatabaseManager& db = DatabaseManager::instance();
+    db.flushWrites();
+    QUuid after;
+    forever {
+        QVector<Item*> page = db.loadItemPage(type, after, PageSize);
+        for (Item* loaded : page) {
+            Item* cached = cache.peek(loaded->itemId);
+            if (cached) {
+                // Visiting may look up other items; keep this one from being evicted meanwhile
+                cache.pin(cached->itemId);
+                visit(cached);
+                cache.unpin(cached->itemId);
+            } else {
+                visit(loaded);
+            }
         }
+        const bool lastPage = page.size() < PageSize;
+        if (!page.isEmpty()) after = page.last()->itemId;
+        qDeleteAll(page);
+        if (lastPage) break;
+    }
+}
+
+// Keeps a lazily loaded item resident while the caller holds its pointer across other lookups. No-op in eager mode
+void LibraryService::pinItem(const QUuid& id) {
+    if (catalogueMode == CatalogueMode::Lazy && lookup(id)) cache.pin(id);
+}
+
+void LibraryService::unpinItem(const QUuid& id) {
+    if (catalogueMode == CatalogueMode::Lazy) cache.unpin(id);
+}
+
+// Full-text search over title, creator, ISBN, genre and Dewey class; see SearchIndex for query semantics
+QVector<Item*> LibraryService::search(const QString& query, int limit) const {
+    return searchIndex.search(query, limit);
+}
+
+// Resolves a scanned or typed ISBN-10 or ISBN-13, with or without hyphens, to every copy carrying it
+QVector<Item*> LibraryService::findItemsByIsbn(const QString& isbn) {
+    const QString normalized = Isbn::normalize(isbn);
+    if (normalized.isEmpty()) return QVector<Item*>();
+    if (catalogueMode == CatalogueMode::Eager) return itemsByIsbn.value(normalized);
+    QVector<Item*> items;
+    DatabaseManager& db = DatabaseManager::instance();
+    db.flushWrites();
+    for (const QUuid& id : db.findItemIdsByIsbn(normalized)) {
+        if (Item* item = lookup(id)) items.append(item);
     }
-    return result;
+    return items;
+}
+
+// Per-value item counts for a facet, optionally restricted to the items matching filters
+QMap<QString, int> LibraryService::facetCounts(Facet facet, const QVector<FacetFilter>& filters) const {
+    return facetIndex.counts(facet, filters);
+}
+
+QVector<Item*> LibraryService::filterByFacets(const QVector<FacetFilter>& filters) const {
+    return facetIndex.filter(filters);
+}
+
+// Changes an item's status and keeps the status facet in step. All status changes go through here
+void LibraryService::setItemStatus(Item* item, ItemStatus status) {
+    if (!item) return;
+    const ItemStatus previousStatus = item->status;
+    item->status = status;
+    if (catalogueMode == CatalogueMode::Eager) facetIndex.updateStatus(item, previousStatus);
+}
+
+// Publishes an item's committed state to catalogue snapshots. Call after every successful change to an item
+void LibraryService::markItemChanged(const Item* item) {
+    if (snapshotsEnabled && item) snapshots.update(item);
+}
+
+// Starts maintaining copy-on-write catalogue snapshots for reader threads. Each snapshot holds a clone of every
+// item, so this roughly doubles catalogue memory; it has no effect in lazy mode
+void LibraryService::enableSnapshots() {
+    if (snapshotsEnabled || catalogueMode == CatalogueMode::Lazy) return;
+    snapshotsEnabled = true;
+    snapshots.reset(catalogue);
+}
+
+// Worker threads read the catalogue through SnapshotPublisher::Reader; the service itself is main thread only
+SnapshotPublisher& LibraryService::snapshotPublisher() {
+    return snapshots;
 }
 
 // Adds a new item to both the catalogue and the database
 void LibraryService::addItem(Item* item) {
-    if (item) {
-        catalogue.append(item);
+    if (item && catalogueMode == CatalogueMode::Lazy) {
+        DatabaseManager::instance().saveItem(item);
+        cache.insert(item);
+    } else if (item) {
+        insertIntoCatalogue(item);
+        indexItem(item);
+        if (snapshotsEnabled) snapshots.append(item);
         DatabaseManager::instance().saveItem(item);
     }
 }
 
 // Removes an item from the catalogue and database
 bool LibraryService::removeItem(const QUuid& id) {
-    for (int i = 0; i < catalogue.size(); ++i) {
-        if (catalogue[i]->itemId == id) {
-            DatabaseManager::instance().deleteItem(id.toString());
-            delete catalogue[i];
-            catalogue.remove(i);
-            return true;
+    if (catalogueMode == CatalogueMode::Lazy) {
+        // A pinned item is still referenced by its holder; deleting it would leave that pointer dangling
+        if (cache.isPinned(id)) {
+            qWarning() << "Refusing to remove item" << id << "while it is pinned";
+            return false;
         }
+        if (!lookup(id)) return false;
+        DatabaseManager::instance().deleteItem(id);
+        cache.remove(id);
+        return true;
     }
-    return false;
+    Item* item = takeFromCatalogue(id);
+    if (!item) return false;
+    DatabaseManager::instance().deleteItem(id);
+    unindexItem(item);
+    if (snapshotsEnabled) snapshots.remove(id);
+    disposeItem(item);
+    return true;
 }
 
-// Clears and reloads the entire catalogue from the database to sync with any external changes
+// Syncs the catalogue with changes made through other connections by re-reading only the items listed in the
+// change log since the last sync. Falls back to a full reload when the log cannot say which items changed, which
+// includes falling behind the log's retention window
 void LibraryService::reloadCatalogue() {
+    DatabaseManager& db = DatabaseManager::instance();
+    db.trimChangeLog();
+    db.flushWrites();
+    DatabaseManager::ChangeSet changes = db.loadChangesSince(appliedChangeSeq);
+    if (catalogueMode == CatalogueMode::Lazy) {
+        if (changes.fullReload) {
+            // Clearing the cache would delete pinned items under their holders, so the reload waits for a call
+            // made while nothing is pinned
+            if (cache.hasPinnedItems()) return;
+            cache.clear();
+            appliedChangeSeq = db.latestChangeSeq();
+            return;
+        }
+        for (const QUuid& id : changes.itemIds) {
+            applyCachedItemChange(id);
+        }
+        appliedChangeSeq = changes.lastSeq;
+        return;
+    }
+    if (changes.fullReload) {
+        releaseCatalogue();
+        loadFullCatalogue();
+        return;
+    }
+    for (const QUuid& id : changes.itemIds) {
+        applyItemChange(id);
+    }
+    appliedChangeSeq = changes.lastSeq;
+}
+
+// Loads every item into the arena. The change log position is read first so that changes made during the load
+// are applied again by the next reloadCatalogue() rather than missed
+void LibraryService::loadFullCatalogue() {
+    DatabaseManager& db = DatabaseManager::instance();
+    appliedChangeSeq = db.latestChangeSeq();
+    catalogue = db.loadAllItems(&arena);
+    rebuildIndex();
+    const StringPool::Stats strings = StringPool::instance().stats();
+    qInfo() << "Loaded" << catalogue.size() << "items; interned attributes:" << strings.uniqueStrings
+            << "unique strings," << strings.uniqueBytes << "bytes stored," << strings.bytesSaved << "bytes saved";
+}
+
+// Replaces the in-memory copy of one item with its current database row, adding or dropping it as needed.
+// A replacement of the same type takes over the old item's positions; otherwise the old item is swap-removed
+void LibraryService::applyItemChange(const QUuid& id) {
+    Item* fresh = DatabaseManager::instance().loadItemById(id, true);
+    auto it = itemsById.find(id);
+    Item* current = it == itemsById.end() ? nullptr : it.value().item;
+    if (current) unindexItem(current);
+    if (current && fresh && fresh->type == current->type) {
+        CatalogueEntry& entry = it.value();
+        catalogue[entry.catalogueIndex] = fresh;
+        itemsByType[static_cast<int>(fresh->type)][entry.partitionIndex] = fresh;
+        entry.item = fresh;
+    } else {
+        if (current) takeFromCatalogue(id);
+        if (fresh) insertIntoCatalogue(fresh);
+    }
+    if (current) disposeItem(current);
+    if (fresh) indexItem(fresh);
+    if (snapshotsEnabled) {
+        if (current && fresh) {
+            snapshots.update(fresh);
+        } else if (current) {
+            snapshots.remove(id);
+        } else if (fresh) {
+            snapshots.append(fresh);
+        }
+    }
+}
+
+// Frees every catalogue item: heap items one by one, then all arena items in a single release
+void LibraryService::releaseCatalogue() {
     for (Item* item : catalogue) {
-        delete item;
+        if (!arena.owns(item)) delete item;
     }
+    arena.release();
+    StringPool::instance().clear();
     catalogue.clear();
-    catalogue = DatabaseManager::instance().loadAllItems();
+    itemsById.clear();
+    for (QVector<Item*>& partition : itemsByType) partition.clear();
+    clearIndexes();
+}
+
+// Frees a single item however it was allocated
+void LibraryService::disposeItem(Item* item) {
+    if (arena.owns(item)) {
+        arena.destroy(item);
+    } else {
+        delete item;
+    }
+}
+
+// Appends an item to the catalogue and its type partition, recording both positions in the id index
+void LibraryService::insertIntoCatalogue(Item* item) {
+    QVector<Item*>& partition = itemsByType[static_cast<int>(item->type)];
+    itemsById.insert(item->itemId, CatalogueEntry{item, catalogue.size(), partition.size()});
+    catalogue.append(item);
+    partition.append(item);
+}
+
+// Removes an item in O(1) by moving the last item of the catalogue and of its partition into the freed slots.
+// Returns the removed item, or nullptr if the id is not in the catalogue
+Item* LibraryService::takeFromCatalogue(const QUuid& id) {
+    auto it = itemsById.find(id);
+    if (it == itemsById.end()) return nullptr;
+    const CatalogueEntry entry = it.value();
+    itemsById.erase(it);
+
+    Item* moved = catalogue.last();
+    catalogue[entry.catalogueIndex] = moved;
+    catalogue.removeLast();
+    if (moved != entry.item) itemsById[moved->itemId].catalogueIndex = entry.catalogueIndex;
+
+    QVector<Item*>& partition = itemsByType[static_cast<int>(entry.item->type)];
+    moved = partition.last();
+    partition[entry.partitionIndex] = moved;
+    partition.removeLast();
+    if (moved != entry.item) itemsById[moved->itemId].partitionIndex = entry.partitionIndex;
+    return entry.item;
+}
+
+// Rebuilds the id index, type partitions and content indexes from scratch after the catalogue has been replaced
+void LibraryService::rebuildIndex() {
+    itemsById.clear();
+    itemsById.reserve(catalogue.size());
+    for (QVector<Item*>& partition : itemsByType) partition.clear();
+    clearIndexes();
+    for (int i = 0; i < catalogue.size(); ++i) {
+        Item* item = catalogue[i];
+        QVector<Item*>& partition = itemsByType[static_cast<int>(item->type)];
+        itemsById.insert(item->itemId, CatalogueEntry{item, i, partition.size()});
+        partition.append(item);
+        indexItem(item);
+    }
+    if (snapshotsEnabled) snapshots.reset(catalogue);
+}
+
+// The normalized ISBN of a book, or an empty string for other items and invalid ISBNs
+static QString normalizedIsbnOf(const Item* item) {
+    if (item->type == ItemType::Fiction) return Isbn::normalize(static_cast<const FictionBook*>(item)->isbn);
+    if (item->type == ItemType::NonFiction) return Isbn::normalize(static_cast<const NonFictionBook*>(item)->isbn);
+    return QString();
+}
+
+// Adds an item to the search, facet and ISBN indexes
+void LibraryService::indexItem(Item* item) {
+    searchIndex.addItem(item);
+    facetIndex.addItem(item);
+    const QString isbn = normalizedIsbnOf(item);
+    if (!isbn.isEmpty()) itemsByIsbn[isbn].append(item);
+}
+
+void LibraryService::unindexItem(Item* item) {
+    searchIndex.removeItem(item);
+    facetIndex.removeItem(item);
+    const QString isbn = normalizedIsbnOf(item);
+    if (isbn.isEmpty()) return;
+    auto it = itemsByIsbn.find(isbn);
+    if (it == itemsByIsbn.end()) return;
+    it.value().removeOne(item);
+    if (it.value().isEmpty()) itemsByIsbn.erase(it);
+}
+
+void LibraryService::clearIndexes() {
+    searchIndex.clear();
+    facetIndex.clear();
+    itemsByIsbn.clear();
+}
+
+// Lazy mode counterpart of applyItemChange(). Unpinned items are simply dropped and reloaded on their next lookup.
+// Pinned items keep their address, so their circulation state is refreshed in place instead
+void LibraryService::applyCachedItemChange(const QUuid& id) {
+    if (!cache.isPinned(id)) {
+        cache.remove(id);
+        return;
+    }
+    Item* cached = cache.peek(id);
+    Item* fresh = DatabaseManager::instance().loadItemById(id);
+    if (cached && fresh) {
+        cached->status = fresh->status;
+        cached->dueDate = fresh->dueDate;
+        cached->holdQueue = fresh->holdQueue;
+    }
+    delete fresh;
 }
@@ -7,25 +7,99 @@
 #include "Magazine.h"
 #include "Movie.h"
 #include "VideoGame.h"
+#include "ItemArena.h"
+#include "SearchIndex.h"
+#include "ItemCache.h"
+#include "FacetIndex.h"
+#include "CatalogueSnapshot.h"
 #include <QVector>
 #include <QUuid>
+#include <QHash>
+#include <functional>
+
+// Eager keeps the whole catalogue in memory. Lazy reads items from the database on demand and keeps a bounded
+// LRU cache of them; getAllItems(), getItemsByType(), search() and the facet queries only cover the catalogue in
+// eager mode
+enum class CatalogueMode {
+    Eager,
+    Lazy
+};
 
 class LibraryService {
 public:
-    LibraryService();
+    explicit LibraryService(CatalogueMode mode = CatalogueMode::Eager, int cacheCapacity = 10000);
     ~LibraryService();
 
+    CatalogueMode mode() const;
+
     Item* findItemById(const QUuid& id);
     const Item* findItemById(const QUuid& id) const;
     QVector<Item*> getAllItems() const;
-    QVector<Item*> getItemsByType(const QString& typeName) const;
+    const QVector<Item*>& getItemsByType(ItemType type) const;
+    void forEachItemOfType(ItemType type, const std::function<void(Item*)>& visit);
+    QVector<Item*> findItemsByIsbn(const QString& isbn);
+    QVector<Item*> search(const QString& query, int limit = 50) const;
+    QMap<QString, int> facetCounts(Facet facet, const QVector<FacetFilter>& filters = QVector<FacetFilter>()) const;
+    QVector<Item*> filterByFacets(const QVector<FacetFilter>& filters) const;
+
+    void setItemStatus(Item* item, ItemStatus status);
+    void markItemChanged(const Item* item);
+
+    void enableSnapshots();
+    SnapshotPublisher& snapshotPublisher();
+
+    void pinItem(const QUuid& id);
+    void unpinItem(const QUuid& id);
 
     void addItem(Item* item);
     bool removeItem(const QUuid& id);
     void reloadCatalogue();
 
 private:
+    // An item with its positions in catalogue and in its type partition
+    struct CatalogueEntry {
+        Item* item;
+        int catalogueIndex;
+        int partitionIndex;
+    };
+
+    void insertIntoCatalogue(Item* item);
+    Item* takeFromCatalogue(const QUuid& id);
+    void rebuildIndex();
+    void releaseCatalogue();
+    void loadFullCatalogue();
+    void applyItemChange(const QUuid& id);
+    void disposeItem(Item* item);
+    Item* lookup(const QUuid& id) const;
+    void indexItem(Item* item);
+    void unindexItem(Item* item);
+    void clearIndexes();
+    void applyCachedItemChange(const QUuid& id);
+
+    // Rows per database page when visiting items in lazy mode
+    static const int PageSize = 500;
+
+    CatalogueMode catalogueMode;
+    // Lazy mode only; lookups fill it, so it is mutable to serve const lookups too
+    mutable ItemCache cache;
+
+    // Items loaded from the database live in arena; items added at runtime are heap allocated
+    ItemArena arena;
     QVector<Item*> catalogue;
+    // Id lookup index over catalogue and the partitions; every change to either must keep it in sync
+    QHash<QUuid, CatalogueEntry> itemsById;
+    // Per-type partitions of catalogue, indexed by ItemType. Removals swap the last item into the gap in both
+    // catalogue and partitions, so neither keeps load order
+    QVector<Item*> itemsByType[ItemTypeCount];
+    SearchIndex searchIndex;
+    FacetIndex facetIndex;
+    // Immutable catalogue versions for reader threads; eager mode only, maintained once enableSnapshots() is called
+    SnapshotPublisher snapshots;
+    bool snapshotsEnabled;
+    // Normalized ISBN-13 to every copy with that ISBN
+    QHash<QString, QVector<Item*>> itemsByIsbn;
+    // Last change log sequence number reflected in the catalogue
+    qint64 appliedChangeSeq;
 };
 
 #endif // LIBRARYSERVICE_H
@@ -1,90 +1,240 @@
 #include "LoanService.h"
 #include "DatabaseManager.h"
+#include <QSet>
 #include <algorithm>
 
-LoanService::LoanService(LibraryService* libService)
-    : libraryService(libService)
+LoanService::LoanService(LibraryService* libService, UserService* userService)
+    : libraryService(libService),
+      userService(userService)
 {
 }
 
 // Processes a borrow request, validating loan limits and item availability before checking out the item
 ActionResult LoanService::borrowItem(Patron* patron, const QUuid& itemId) {
+    return borrowItems(patron, {itemId}).first().result;
+}
+
+// Processes a return, updating item status to OnHold if others are waiting or Available otherwise
+ActionResult LoanService::returnItem(Patron* patron, const QUuid& itemId) {
+    return returnItems(patron, {itemId}).first().result;
+}
+
+// Checks out several items in one unit of work, e.g. a bulk checkout at the desk. Every item is validated before
+// anything is written, counting the loans earlier items in the batch will add; items that fail validation are
+// skipped and the rest are saved together. Each accepted item is pinned as soon as it is validated, so later
+// lookups in the batch cannot evict it from a lazy catalogue. Returns one result per requested id, in order. With
+// write-behind the writes are only queued; if the worker rolls them back, the batch's state is restored then
+QVector<LoanService::ItemResult> LoanService::borrowItems(Patron* patron, const QVector<QUuid>& itemIds) {
+    QVector<ItemResult> results;
+    results.reserve(itemIds.size());
     if (!patron) {
-        return {false, "No patron logged in."};
+        for (const QUuid& id : itemIds) results.append({id, {false, "No patron logged in."}});
+        return results;
+    }
+
+    QVector<int> accepted;
+    QVector<Item*> items;
+    QVector<bool> holdsFulfilled;
+    QSet<QUuid> seen;
+    int loanCount = patron->activeLoans.size();
+    for (const QUuid& id : itemIds) {
+        Item* item = nullptr;
+        bool fulfilsHold = false;
+        ActionResult check = seen.contains(id)
+            ? ActionResult{false, "Item is already in this checkout."}
+            : validateBorrow(*patron, id, loanCount, item, fulfilsHold);
+        results.append({id, check});
+        if (!check.ok) continue;
+        libraryService->pinItem(id);
+        seen.insert(id);
+        ++loanCount;
+        accepted.append(results.size() - 1);
+        items.append(item);
+        holdsFulfilled.append(fulfilsHold);
     }
+    if (items.isEmpty()) return results;
 
-    Item* item = libraryService->findItemById(itemId);
+    // Keep the in-memory state so it can be restored if the unit of work does not commit, now or later
+    const BatchState previous = captureBatch(patron, items);
+
+    DatabaseManager& db = DatabaseManager::instance();
+    bool ok = db.beginUnitOfWork();
+    for (int i = 0; ok && i < items.size(); ++i) {
+        ok = applyBorrow(patron, items[i], holdsFulfilled[i]);
+    }
+    if (!ok) db.rollbackUnitOfWork();
+    if (!ok || !db.commitUnitOfWork([this, previous]() { restoreBatch(previous); })) {
+        restoreBatch(previous);
+        for (int index : accepted) results[index].result = {false, "Could not save the loan. Please try again."};
+    } else {
+        for (Item* item : items) libraryService->markItemChanged(item);
+        for (int index : accepted) results[index].result = {true, "Borrowed successfully."};
+    }
+    unpinItems(items);
+    return results;
+}
+
+// Returns several of the patron's loans in one unit of work, e.g. when emptying the book drop. Validation,
+// partial acceptance and results work as in borrowItems()
+QVector<LoanService::ItemResult> LoanService::returnItems(Patron* patron, const QVector<QUuid>& itemIds) {
+    QVector<ItemResult> results;
+    results.reserve(itemIds.size());
+    if (!patron) {
+        for (const QUuid& id : itemIds) results.append({id, {false, "No patron logged in."}});
+        return results;
+    }
+
+    QVector<int> accepted;
+    QVector<Item*> items;
+    QSet<QUuid> seen;
+    for (const QUuid& id : itemIds) {
+        Item* item = nullptr;
+        ActionResult check = seen.contains(id)
+            ? ActionResult{false, "Item is already in this return."}
+            : validateReturn(*patron, id, item);
+        results.append({id, check});
+        if (!check.ok) continue;
+        libraryService->pinItem(id);
+        seen.insert(id);
+        accepted.append(results.size() - 1);
+        items.append(item);
+    }
+    if (items.isEmpty()) return results;
+
+    const BatchState previous = captureBatch(patron, items);
+
+    DatabaseManager& db = DatabaseManager::instance();
+    bool ok = db.beginUnitOfWork();
+    for (int i = 0; ok && i < items.size(); ++i) {
+        ok = applyReturn(patron, items[i]);
+    }
+    if (!ok) db.rollbackUnitOfWork();
+    if (!ok || !db.commitUnitOfWork([this, previous]() { restoreBatch(previous); })) {
+        restoreBatch(previous);
+        for (int index : accepted) results[index].result = {false, "Could not save the return. Please try again."};
+    } else {
+        for (Item* item : items) libraryService->markItemChanged(item);
+        for (int index : accepted) results[index].result = {true, "Returned successfully."};
+    }
+    unpinItems(items);
+    return results;
+}
+
+// Releases the pins taken on a batch's items during validation
+void LoanService::unpinItems(const QVector<Item*>& items) {
+    for (Item* item : items) libraryService->unpinItem(item->itemId);
+}
+
+// Checks a single borrow against the patron's state, with loanCount standing in for their current number of loans.
+// On success sets item, and fulfilsHold when the loan consumes the patron's hold at the front of the queue
+ActionResult LoanService::validateBorrow(const Patron& patron, const QUuid& itemId, int loanCount,
+                                         Item*& item, bool& fulfilsHold) const {
+    item = libraryService->findItemById(itemId);
     if (!item) {
         return {false, "Item not found."};
     }
 
-    if (patronHasLoan(*patron, itemId)) {
+    if (patronHasLoan(patron, itemId)) {
         return {false, "You already borrowed this item."};
     }
 
-    if (patron->activeLoans.size() >= 3) {
+    if (loanCount >= 3) {
         return {false, "Max 3 active loans reached (D1)."};
     }
 
+    fulfilsHold = false;
     switch (item->status) {
         case ItemStatus::Available:
             break;
         case ItemStatus::CheckedOut:
             return {false, "Item is already checked out."};
         case ItemStatus::OnHold:
-            if (item->holdQueue.isEmpty() || item->holdQueue.front() != patron->name) {
+            if (!item->holdQueue.isFront(patron.name)) {
                 return {false, "Item is on hold for another patron."};
             }
-            item->holdQueue.pop_front();
-            DatabaseManager::instance().deleteHold(patron->name, itemId.toString());
-            DatabaseManager::instance().updateHoldPositions(itemId.toString(), item->holdQueue);
+            fulfilsHold = true;
             break;
     }
+    return {true, QString()};
+}
 
-    item->status = ItemStatus::CheckedOut;
-    item->dueDate = QDate::currentDate().addDays(14);
-    patron->activeLoans.push_back(itemId);
-
-    DatabaseManager::instance().updateItem(item);
-    DatabaseManager::instance().saveLoan(patron->name, itemId.toString(), item->dueDate);
-
-    auto holdIt = std::find(patron->activeHolds.begin(), patron->activeHolds.end(), itemId);
-    if (holdIt != patron->activeHolds.end()) {
-        patron->activeHolds.erase(holdIt);
+ActionResult LoanService::validateReturn(const Patron& patron, const QUuid& itemId, Item*& item) const {
+    item = libraryService->findItemById(itemId);
+    if (!item) {
+        return {false, "Item not found."};
     }
 
-    return {true, "Borrowed successfully."};
+    if (item->status != ItemStatus::CheckedOut || !patronHasLoan(patron, itemId)) {
+        return {false, "You don't have this item on loan."};
+    }
+    return {true, QString()};
 }
 
-// Processes a return, updating item status to OnHold if others are waiting or Available otherwise
-ActionResult LoanService::returnItem(Patron* patron, const QUuid& itemId) {
-    if (!patron) {
-        return {false, "No patron logged in."};
-    }
+// Checks out a validated item in memory and queues its writes in the open unit of work
+bool LoanService::applyBorrow(Patron* patron, Item* item, bool fulfilsHold) {
+    DatabaseManager& db = DatabaseManager::instance();
+    bool ok = true;
 
-    Item* item = libraryService->findItemById(itemId);
-    if (!item) {
-        return {false, "Item not found."};
+    if (fulfilsHold) {
+        item->holdQueue.dequeue();
+        ok = db.deleteHold(patron->name, item->itemId);
     }
 
-    auto itPos = std::find(patron->activeLoans.begin(), patron->activeLoans.end(), itemId);
-    if (item->status != ItemStatus::CheckedOut || itPos == patron->activeLoans.end()) {
-        return {false, "You don't have this item on loan."};
+    libraryService->setItemStatus(item, ItemStatus::CheckedOut);
+    item->dueDate = QDate::currentDate().addDays(14);
+    patron->activeLoans.push_back(item->itemId);
+
+    ok = ok && db.updateItem(item);
+    ok = ok && db.saveLoan(patron->name, item->itemId, item->dueDate);
+
+    auto holdIt = std::find(patron->activeHolds.begin(), patron->activeHolds.end(), item->itemId);
+    if (holdIt != patron->activeHolds.end()) {
+        patron->activeHolds.erase(holdIt);
     }
+    return ok;
+}
 
-    patron->activeLoans.erase(itPos);
-    DatabaseManager::instance().deleteLoan(patron->name, itemId.toString());
+// Returns a validated loan in memory and queues its writes in the open unit of work
+bool LoanService::applyReturn(Patron* patron, Item* item) {
+    DatabaseManager& db = DatabaseManager::instance();
+
+    patron->activeLoans.removeOne(item->itemId);
+    bool ok = db.deleteLoan(patron->name, item->itemId);
 
     if (!item->holdQueue.isEmpty()) {
-        item->status = ItemStatus::OnHold;
+        libraryService->setItemStatus(item, ItemStatus::OnHold);
     } else {
-        item->status = ItemStatus::Available;
+        libraryService->setItemStatus(item, ItemStatus::Available);
     }
 
     item->dueDate = QDate();
-    DatabaseManager::instance().updateItem(item);
+    return ok && db.updateItem(item);
+}
 
-    return {true, "Returned successfully."};
+LoanService::BatchState LoanService::captureBatch(const Patron* patron, const QVector<Item*>& items) const {
+    BatchState state{patron->name, patron->activeLoans, patron->activeHolds, QVector<ItemState>()};
+    state.items.reserve(items.size());
+    for (const Item* item : items) {
+        state.items.append({item->itemId, item->status, item->dueDate, item->holdQueue});
+    }
+    return state;
+}
+
+// Puts back the state captured before a batch. A patron who is no longer loaded needs nothing: their state is
+// read again from the database, which never received the batch
+void LoanService::restoreBatch(const BatchState& state) {
+    for (const ItemState& itemState : state.items) {
+        Item* item = libraryService->findItemById(itemState.itemId);
+        if (!item) continue;
+        libraryService->setItemStatus(item, itemState.status);
+        item->dueDate = itemState.dueDate;
+        item->holdQueue = itemState.holdQueue;
+        libraryService->markItemChanged(item);
+    }
+    if (Patron* patron = userService->loadedPatron(state.patronName)) {
+        patron->activeLoans = state.activeLoans;
+        patron->activeHolds = state.activeHolds;
+    }
 }
 
 // Checks if the patron currently has the specified item on loan
@@ -99,8 +249,7 @@ bool LoanService::canBorrow(const Patron* patron, const Item* item) const {
     if (patronHasLoan(*patron, item->itemId)) return false;
     if (patron->activeLoans.size() >= 3) return false;
     if (item->status == ItemStatus::CheckedOut) return false;
-    if (item->status == ItemStatus::OnHold &&
-        (item->holdQueue.isEmpty() || item->holdQueue.front() != patron->name)) {
+    if (item->status == ItemStatus::OnHold && !item->holdQueue.isFront(patron->name)) {
         return false;
     }
     return true;
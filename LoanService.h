@@ -4,23 +4,60 @@
 #include "User.h"
 #include "Item.h"
 #include "LibraryService.h"
+#include "UserService.h"
 #include <QUuid>
 #include <QDate>
+#include <QVector>
 
 class LoanService {
 public:
-    explicit LoanService(LibraryService* libService);
+    LoanService(LibraryService* libService, UserService* userService);
+
+    // Outcome of one item in a batch operation
+    struct ItemResult {
+        QUuid itemId;
+        ActionResult result;
+    };
 
     // Loan operations
     ActionResult borrowItem(Patron* patron, const QUuid& itemId);
     ActionResult returnItem(Patron* patron, const QUuid& itemId);
+    QVector<ItemResult> borrowItems(Patron* patron, const QVector<QUuid>& itemIds);
+    QVector<ItemResult> returnItems(Patron* patron, const QVector<QUuid>& itemIds);
 
     // Query helpers
     bool patronHasLoan(const Patron& patron, const QUuid& itemId) const;
     bool canBorrow(const Patron* patron, const Item* item) const;
 
 private:
+    // In-memory circulation state of an item, restored if a batch does not commit
+    struct ItemState {
+        QUuid itemId;
+        ItemStatus status;
+        QDate dueDate;
+        HoldQueue holdQueue;
+    };
+
+    // Everything a batch changes in memory. The write-behind worker can report a rollback after the batch has
+    // returned, so the patron and items are looked up again by name and id rather than held by pointer
+    struct BatchState {
+        QString patronName;
+        QVector<QUuid> activeLoans;
+        QVector<QUuid> activeHolds;
+        QVector<ItemState> items;
+    };
+
+    ActionResult validateBorrow(const Patron& patron, const QUuid& itemId, int loanCount,
+                                Item*& item, bool& fulfilsHold) const;
+    ActionResult validateReturn(const Patron& patron, const QUuid& itemId, Item*& item) const;
+    bool applyBorrow(Patron* patron, Item* item, bool fulfilsHold);
+    bool applyReturn(Patron* patron, Item* item);
+    BatchState captureBatch(const Patron* patron, const QVector<Item*>& items) const;
+    void restoreBatch(const BatchState& state);
+    void unpinItems(const QVector<Item*>& items);
+
     LibraryService* libraryService;
+    UserService* userService;
 };
 
 #endif // LOANSERVICE_H
@@ -7,10 +7,14 @@ Magazine::Magazine(const QString& title,
                    ItemCondition condition,
                    int issueNum,
                    const QDate& pubDate)
-    : Item(title, publisher, year, format, condition), issueNumber(issueNum), publicationDate(pubDate)
+    : Item(ItemType::Magazine, title, publisher, year, format, condition), issueNumber(issueNum), publicationDate(pubDate)
 {
 }
 
 QString Magazine::typeName() const {
     return "Magazine";
 }
+
+Item* Magazine::clone() const {
+    return new Magazine(*this);
+}
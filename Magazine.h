@@ -17,6 +17,7 @@ public:
              const QDate& pubDate);
 
     QString typeName() const override;
+    Item* clone() const override;
 };
 
 #endif // MAGAZINE_H
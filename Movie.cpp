@@ -7,10 +7,14 @@ Movie::Movie(const QString& title,
              ItemCondition condition,
              const QString& genre,
              int rating)
-    : Item(title, director, year, format, condition), genre(genre), rating(rating)
+    : Item(ItemType::Movie, title, director, year, format, condition), genre(genre), rating(rating)
 {
 }
 
 QString Movie::typeName() const {
     return "Movie";
 }
+
+Item* Movie::clone() const {
+    return new Movie(*this);
+}
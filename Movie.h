@@ -17,6 +17,7 @@ public:
           int rating);
 
     QString typeName() const override;
+    Item* clone() const override;
 };
 
 #endif // MOVIE_H
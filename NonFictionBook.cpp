@@ -7,10 +7,14 @@ NonFictionBook::NonFictionBook(const QString& title,
                                ItemCondition condition,
                                const QString& isbnNum,
                                const QString& deweyClass)
-    : Item(title, author, year, format, condition), isbn(isbnNum), deweyClass(deweyClass)
+    : Item(ItemType::NonFiction, title, author, year, format, condition), isbn(isbnNum), deweyClass(deweyClass)
 {
 }
 
 QString NonFictionBook::typeName() const {
     return "Non-Fiction";
 }
+
+Item* NonFictionBook::clone() const {
+    return new NonFictionBook(*this);
+}
@@ -17,6 +17,7 @@ public:
                    const QString& deweyClass);
 
     QString typeName() const override;
+    Item* clone() const override;
 };
 
 #endif // NONFICTIONBOOK_H
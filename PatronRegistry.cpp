@@ -0,0 +1,118 @@
+#include "PatronRegistry.h"
+#include "DatabaseManager.h"
+#include <QtGlobal>
+
+PatronRegistry::PatronRegistry(int capacity)
+    : capacity(qMax(1, capacity))
+{
+}
+
+PatronRegistry::~PatronRegistry() {
+    clearLoaded();
+}
+
+// Replaces the registry with the given accounts. Every handle and Patron* handed out earlier becomes invalid
+void PatronRegistry::reset(const QStringList& names) {
+    clearLoaded();
+    pins.clear();
+    this->names = names;
+}
+
+// Registers a new account with already known state and returns its handle
+PatronHandle PatronRegistry::add(const Patron& patron) {
+    const PatronHandle handle = names.size();
+    names.append(patron.name);
+    insert(handle, new Patron(patron));
+    return handle;
+}
+
+int PatronRegistry::count() const {
+    return names.size();
+}
+
+QString PatronRegistry::name(PatronHandle handle) const {
+    return handle >= 0 && handle < names.size() ? names[handle] : QString();
+}
+
+// Returns the patron's state, loading it from the database on a miss. Returns nullptr for invalid handles or
+// accounts that no longer exist
+Patron* PatronRegistry::get(PatronHandle handle) {
+    if (handle < 0 || handle >= names.size()) return nullptr;
+    auto it = loaded.find(handle);
+    if (it != loaded.end()) {
+        recency.splice(recency.begin(), recency, it.value().position);
+        return it.value().patron;
+    }
+    DatabaseManager& db = DatabaseManager::instance();
+    // Queued write-behind batches may still hold this patron's latest loans and holds
+    db.flushWrites();
+    Patron* patron = new Patron();
+    if (!db.loadPatron(names[handle], *patron)) {
+        delete patron;
+        return nullptr;
+    }
+    insert(handle, patron);
+    return patron;
+}
+
+// Returns the patron's state only if it is already loaded, without loading it or touching the LRU order
+Patron* PatronRegistry::peek(PatronHandle handle) const {
+    auto it = loaded.constFind(handle);
+    return it == loaded.constEnd() ? nullptr : it.value().patron;
+}
+
+// Drops a patron's loaded state so the next get() re-reads it. Pinned patrons keep their state
+void PatronRegistry::invalidate(PatronHandle handle) {
+    if (pins.contains(handle)) return;
+    auto it = loaded.find(handle);
+    if (it == loaded.end()) return;
+    delete it.value().patron;
+    recency.erase(it.value().position);
+    loaded.erase(it);
+}
+
+void PatronRegistry::pin(PatronHandle handle) {
+    if (handle >= 0 && handle < names.size()) ++pins[handle];
+}
+
+void PatronRegistry::unpin(PatronHandle handle) {
+    auto it = pins.find(handle);
+    if (it == pins.end()) return;
+    if (--it.value() == 0) pins.erase(it);
+    evictOverflow(InvalidPatronHandle);
+}
+
+int PatronRegistry::loadedCount() const {
+    return loaded.size();
+}
+
+void PatronRegistry::insert(PatronHandle handle, Patron* patron) {
+    recency.push_front(handle);
+    loaded.insert(handle, Entry{patron, recency.begin()});
+    evictOverflow(handle);
+}
+
+// Evicts least recently used, unpinned patrons until the cache fits, never evicting keep
+void PatronRegistry::evictOverflow(PatronHandle keep) {
+    int skipped = 0;
+    while (loaded.size() > capacity && skipped < loaded.size()) {
+        const PatronHandle handle = recency.back();
+        auto it = loaded.find(handle);
+        if (handle == keep || pins.contains(handle)) {
+            recency.splice(recency.begin(), recency, it.value().position);
+            ++skipped;
+            continue;
+        }
+        delete it.value().patron;
+        recency.pop_back();
+        loaded.erase(it);
+    }
+}
+
+void PatronRegistry::clearLoaded() {
+    for (const Entry& entry : loaded) {
+        delete entry.patron;
+    }
+    loaded.clear();
+    recency.clear();
+}
@@ -0,0 +1,59 @@
+#ifndef PATRONREGISTRY_H
+#define PATRONREGISTRY_H
+
+#include "User.h"
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <list>
+
+// Stable identifier for a patron account; an index that stays valid for the life of the registry
+typedef int PatronHandle;
+const PatronHandle InvalidPatronHandle = -1;
+
+// Every patron account by handle, with a bounded LRU cache of their loaded state (fines, loans and holds).
+// State is read from the database on first use. A Patron* returned by get() stays valid until the patron is
+// evicted, which never happens while it is pinned
+class PatronRegistry {
+public:
+    explicit PatronRegistry(int capacity = 1024);
+    ~PatronRegistry();
+
+    void reset(const QStringList& names);
+    PatronHandle add(const Patron& patron);
+
+    int count() const;
+    QString name(PatronHandle handle) const;
+    Patron* get(PatronHandle handle);
+    Patron* peek(PatronHandle handle) const;
+    void invalidate(PatronHandle handle);
+
+    void pin(PatronHandle handle);
+    void unpin(PatronHandle handle);
+
+    int loadedCount() const;
+
+private:
+    PatronRegistry(const PatronRegistry&) = delete;
+    PatronRegistry& operator=(const PatronRegistry&) = delete;
+
+    struct Entry {
+        Patron* patron;
+        std::list<PatronHandle>::iterator position;
+    };
+
+    void insert(PatronHandle handle, Patron* patron);
+    void evictOverflow(PatronHandle keep);
+    void clearLoaded();
+
+    int capacity;
+    QVector<QString> names;
+    // Pin counts by handle; only pinned patrons appear here
+    QHash<PatronHandle, int> pins;
+    // Most recently used first
+    std::list<PatronHandle> recency;
+    QHash<PatronHandle, Entry> loaded;
+};
+
+#endif // PATRONREGISTRY_H
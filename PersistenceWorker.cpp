@@ -0,0 +1,250 @@
+#include "PersistenceWorker.h"
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QMutexLocker>
+#include <QDebug>
+
+WriteCommand::WriteCommand() {
+}
+
+WriteCommand::WriteCommand(const QString& statementId, const QString& sql)
+    : statementId(statementId), sql(sql)
+{
+}
+
+void WriteCommand::bind(const QString& placeholder, const QVariant& value) {
+    bindings.append(qMakePair(placeholder, value));
+}
+
+PersistenceWorker::PersistenceWorker(const QString& dbPath, const QStringList& connectionSetup,
+                                     int queueCapacity, int maxGroupSize)
+    : dbPath(dbPath),
+      connectionName(QString("hinlibs-writer-%1").arg(reinterpret_cast<quintptr>(this))),
+      connectionSetup(connectionSetup),
+      queueCapacity(qMax(1, queueCapacity)),
+      maxGroupSize(qMax(1, maxGroupSize)),
+      inFlight(0),
+      nextTicket(1),
+      completedTicket(0),
+      failedBatches(0),
+      failedSinceFlush(0),
+      stopping(false),
+      startup(Startup::Pending)
+{
+}
+
+PersistenceWorker::~PersistenceWorker() {
+    stop();
+}
+
+// Queues a batch for the worker, blocking the caller while the queue is full. Returns the batch's ticket, or 0 once
+// the worker is stopping. A tracked batch's failure is reported only through waitFor() or takeFailedTickets()
+qint64 PersistenceWorker::enqueue(const WriteBatch& batch, bool tracked) {
+    QMutexLocker locker(&mutex);
+    while (!stopping && queue.size() >= queueCapacity) {
+        notFull.wait(&mutex);
+    }
+    if (stopping) return 0;
+    const qint64 ticket = nextTicket++;
+    queue.enqueue(QueuedBatch{ticket, batch, tracked});
+    notEmpty.wakeOne();
+    return ticket;
+}
+
+// Blocks until the worker's connection is open and set up. Returns false if either step failed, in which case the
+// worker has stopped. Only valid after start()
+bool PersistenceWorker::waitForStartup() {
+    QMutexLocker locker(&mutex);
+    while (startup == Startup::Pending) {
+        startupDone.wait(&mutex);
+    }
+    return startup == Startup::Ready;
+}
+
+// Blocks until the batch with the given ticket has been processed. Returns true if it was committed
+bool PersistenceWorker::waitFor(qint64 ticket) {
+    if (ticket <= 0) return false;
+    QMutexLocker locker(&mutex);
+    while (completedTicket < ticket) {
+        completed.wait(&mutex);
+    }
+    return !failedTickets.remove(ticket);
+}
+
+// Highest ticket such that it and every ticket before it have been committed or have failed
+qint64 PersistenceWorker::completedThrough() const {
+    QMutexLocker locker(&mutex);
+    return completedTicket;
+}
+
+// Removes and returns the failed tracked tickets up to and including throughTicket, without blocking
+QSet<qint64> PersistenceWorker::takeFailedTickets(qint64 throughTicket) {
+    QMutexLocker locker(&mutex);
+    QSet<qint64> taken;
+    for (auto it = failedTickets.begin(); it != failedTickets.end();) {
+        if (*it <= throughTicket) {
+            taken.insert(*it);
+            it = failedTickets.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    return taken;
+}
+
+// Waits until every batch queued so far has been committed. Returns false if any untracked batch failed since the
+// last flush
+bool PersistenceWorker::flush() {
+    QMutexLocker locker(&mutex);
+    while (isRunning() && (!queue.isEmpty() || inFlight > 0)) {
+        drained.wait(&mutex);
+    }
+    bool ok = failedSinceFlush == 0 && queue.isEmpty();
+    failedSinceFlush = 0;
+    return ok;
+}
+
+// Drains the queue and stops the thread
+void PersistenceWorker::stop() {
+    {
+        QMutexLocker locker(&mutex);
+        stopping = true;
+        notEmpty.wakeAll();
+        notFull.wakeAll();
+    }
+    wait();
+}
+
+int PersistenceWorker::failedBatchCount() const {
+    QMutexLocker locker(&mutex);
+    return failedBatches;
+}
+
+// Returns the number of untracked batches that failed since the last call, e.g. to tell the user
+int PersistenceWorker::takeFailedBatchCount() {
+    QMutexLocker locker(&mutex);
+    const int count = failedBatches;
+    failedBatches = 0;
+    return count;
+}
+
+// Called with the mutex held
+void PersistenceWorker::recordFailure(const QueuedBatch& queued) {
+    if (queued.tracked) {
+        failedTickets.insert(queued.ticket);
+    } else {
+        ++failedBatches;
+        ++failedSinceFlush;
+    }
+}
+
+void PersistenceWorker::run() {
+    {
+        QSqlDatabase connection = QSqlDatabase::addDatabase("QSQLITE", connectionName);
+        connection.setDatabaseName(dbPath);
+        bool ready = connection.open();
+        if (!ready) {
+            qWarning() << "Write-behind connection failed to open:" << connection.lastError().text();
+        } else {
+            // The setup installs the change origin trigger; without it this connection's writes would look like
+            // another process's
+            QSqlQuery setupQuery(connection);
+            for (const QString& statement : connectionSetup) {
+                if (!setupQuery.exec(statement)) {
+                    qWarning() << "Write-behind connection setup failed:" << statement << ":"
+                               << setupQuery.lastError().text();
+                    ready = false;
+                    break;
+                }
+            }
+        }
+        {
+            QMutexLocker locker(&mutex);
+            startup = ready ? Startup::Ready : Startup::Failed;
+            startupDone.wakeAll();
+            if (!ready) {
+                // Fail anything already queued; the loop below then exits at once
+                for (const QueuedBatch& queued : queue) recordFailure(queued);
+                queue.clear();
+                stopping = true;
+                completedTicket = nextTicket - 1;
+                notFull.wakeAll();
+                completed.wakeAll();
+            }
+        }
+
+        forever {
+            QVector<QueuedBatch> group;
+            {
+                QMutexLocker locker(&mutex);
+                while (queue.isEmpty() && !stopping) {
+                    notEmpty.wait(&mutex);
+                }
+                if (queue.isEmpty()) break;
+                while (!queue.isEmpty() && group.size() < maxGroupSize) {
+                    group.append(queue.dequeue());
+                }
+                inFlight = group.size();
+                notFull.wakeAll();
+            }
+
+            // Group commit: every batch in the group shares one transaction. If the group fails, replay each
+            // batch in its own transaction so one bad batch cannot discard the others
+            QVector<QueuedBatch> failed;
+            bool groupOk = connection.transaction();
+            for (int i = 0; groupOk && i < group.size(); ++i) {
+                groupOk = applyBatch(connection, group[i].batch);
+            }
+            if (groupOk) groupOk = connection.commit();
+            if (!groupOk) {
+                connection.rollback();
+                for (const QueuedBatch& queued : group) {
+                    bool ok = connection.transaction() && applyBatch(connection, queued.batch) && connection.commit();
+                    if (!ok) {
+                        connection.rollback();
+                        failed.append(queued);
+                    }
+                }
+            }
+
+            QMutexLocker locker(&mutex);
+            inFlight = 0;
+            for (const QueuedBatch& queued : failed) recordFailure(queued);
+            completedTicket = group.last().ticket;
+            completed.wakeAll();
+            if (queue.isEmpty()) drained.wakeAll();
+        }
+
+        qDeleteAll(statementCache);
+        statementCache.clear();
+        connection.close();
+    }
+    QSqlDatabase::removeDatabase(connectionName);
+    QMutexLocker locker(&mutex);
+    drained.wakeAll();
+}
+
+// Executes the commands of one batch on the worker's connection, preparing each statement id once
+bool PersistenceWorker::applyBatch(QSqlDatabase& connection, const WriteBatch& batch) {
+    for (const WriteCommand& command : batch) {
+        QSqlQuery* query = statementCache.value(command.statementId);
+        if (!query) {
+            query = new QSqlQuery(connection);
+            if (!query->prepare(command.sql)) {
+                qWarning() << "Write-behind failed to prepare" << command.statementId << ":" << query->lastError().text();
+                delete query;
+                return false;
+            }
+            statementCache.insert(command.statementId, query);
+        }
+        for (const auto& binding : command.bindings) {
+            query->bindValue(binding.first, binding.second);
+        }
+        if (!query->exec()) {
+            qWarning() << "Write-behind failed to execute" << command.statementId << ":" << query->lastError().text();
+            return false;
+        }
+    }
+    return true;
+}
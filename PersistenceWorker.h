@@ -0,0 +1,104 @@
+#ifndef PERSISTENCEWORKER_H
+#define PERSISTENCEWORKER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QQueue>
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QVariant>
+#include <QVector>
+#include <QPair>
+#include <QSet>
+
+class QSqlDatabase;
+class QSqlQuery;
+
+// A single parameterized write statement. statementId keys the worker's prepared-statement cache
+struct WriteCommand {
+    QString statementId;
+    QString sql;
+    QVector<QPair<QString, QVariant>> bindings;
+
+    WriteCommand();
+    WriteCommand(const QString& statementId, const QString& sql);
+
+    void bind(const QString& placeholder, const QVariant& value);
+};
+
+// All the writes of one unit of work; a batch is always committed or rolled back as a whole
+typedef QVector<WriteCommand> WriteBatch;
+
+// Background thread that owns its own SQLite connection and applies queued write batches.
+// Batches waiting in the queue are group-committed: up to maxGroupSize of them share one transaction.
+// Every batch gets a ticket. The failure of a tracked batch is kept by ticket, for waitFor() to block on or for
+// takeFailedTickets() to collect once the batch has completed; failures of untracked batches are only counted.
+class PersistenceWorker : public QThread {
+public:
+    PersistenceWorker(const QString& dbPath, const QStringList& connectionSetup,
+                      int queueCapacity, int maxGroupSize);
+    ~PersistenceWorker();
+
+    bool waitForStartup();
+    qint64 enqueue(const WriteBatch& batch, bool tracked = false);
+    bool waitFor(qint64 ticket);
+    qint64 completedThrough() const;
+    QSet<qint64> takeFailedTickets(qint64 throughTicket);
+    bool flush();
+    void stop();
+
+    int failedBatchCount() const;
+    int takeFailedBatchCount();
+
+protected:
+    void run() override;
+
+private:
+    enum class Startup {
+        Pending,
+        Ready,
+        Failed
+    };
+
+    struct QueuedBatch {
+        qint64 ticket;
+        WriteBatch batch;
+        bool tracked;
+    };
+
+    bool applyBatch(QSqlDatabase& connection, const WriteBatch& batch);
+    void recordFailure(const QueuedBatch& queued);
+
+    QString dbPath;
+    QString connectionName;
+    QStringList connectionSetup;
+    int queueCapacity;
+    int maxGroupSize;
+
+    mutable QMutex mutex;
+    QWaitCondition notEmpty;
+    QWaitCondition notFull;
+    QWaitCondition drained;
+    QWaitCondition completed;
+    QWaitCondition startupDone;
+    QQueue<QueuedBatch> queue;
+    int inFlight;
+    qint64 nextTicket;
+    // Every ticket up to and including this one has been committed or has failed
+    qint64 completedTicket;
+    // Tracked batches that failed, until waitFor() or takeFailedTickets() collects them
+    QSet<qint64> failedTickets;
+    // Untracked failures not yet collected by takeFailedBatchCount()
+    int failedBatches;
+    // Untracked failures since the last flush()
+    int failedSinceFlush;
+    bool stopping;
+    Startup startup;
+
+    // Prepared statements on the worker's connection; only touched from the worker thread
+    QHash<QString, QSqlQuery*> statementCache;
+};
+
+#endif // PERSISTENCEWORKER_H
@@ -0,0 +1,160 @@
+#include "SearchIndex.h"
+#include "FictionBook.h"
+#include "NonFictionBook.h"
+#include "Movie.h"
+#include "VideoGame.h"
+#include <algorithm>
+
+// Per-field weights used when ranking results
+static const int TitleWeight = 4;
+static const int CreatorWeight = 3;
+static const int CodeWeight = 5;
+static const int GenreWeight = 2;
+static const int DeweyWeight = 2;
+
+// Indexes every term of an item's searchable fields
+void SearchIndex::addItem(const Item* item) {
+    if (!item) return;
+    Item* key = const_cast<Item*>(item);
+    for (const FieldTerm& field : termsForItem(item)) {
+        postings[field.term][key] += field.weight;
+    }
+}
+
+// Removes an item from every posting list it appears in. Must be called before the item's fields change or it is freed
+void SearchIndex::removeItem(const Item* item) {
+    if (!item) return;
+    Item* key = const_cast<Item*>(item);
+    for (const FieldTerm& field : termsForItem(item)) {
+        auto it = postings.find(field.term);
+        if (it == postings.end()) continue;
+        it.value().remove(key);
+        if (it.value().isEmpty()) postings.erase(it);
+    }
+}
+
+void SearchIndex::clear() {
+    postings.clear();
+}
+
+// Returns up to limit items matching every term of the query, best matches first
+QVector<Item*> SearchIndex::search(const QString& query, int limit) const {
+    QVector<Item*> results;
+    QStringList terms = tokenize(query);
+    if (terms.isEmpty() || limit <= 0) return results;
+    // A punctuated code such as "978-0-14" tokenizes into pieces; prefer matching it as one compact code term
+    const QString compact = terms.join(QString());
+    if (terms.size() > 1 && compact.at(0).isDigit() && !matchesFor(compact).isEmpty()) {
+        terms = QStringList{compact};
+    }
+
+    // Intersect starting from the rarest term so the candidate set only shrinks
+    QVector<Postings> matches;
+    for (const QString& term : terms) {
+        Postings termMatches = matchesFor(term);
+        if (termMatches.isEmpty()) return results;
+        matches.append(termMatches);
+    }
+    std::sort(matches.begin(), matches.end(), [](const Postings& a, const Postings& b) {
+        return a.size() < b.size();
+    });
+    Postings scores = matches.first();
+    for (int i = 1; i < matches.size() && !scores.isEmpty(); ++i) {
+        for (auto it = scores.begin(); it != scores.end();) {
+            auto match = matches[i].constFind(it.key());
+            if (match == matches[i].constEnd()) {
+                it = scores.erase(it);
+            } else {
+                it.value() += match.value();
+                ++it;
+            }
+        }
+    }
+
+    QVector<QPair<int, Item*>> ranked;
+    ranked.reserve(scores.size());
+    for (auto it = scores.constBegin(); it != scores.constEnd(); ++it) {
+        ranked.append(qMakePair(it.value(), it.key()));
+    }
+    auto byRank = [](const QPair<int, Item*>& a, const QPair<int, Item*>& b) {
+        if (a.first != b.first) return a.first > b.first;
+        return a.second->title < b.second->title;
+    };
+    const int count = qMin(limit, ranked.size());
+    std::partial_sort(ranked.begin(), ranked.begin() + count, ranked.end(), byRank);
+    results.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        results.append(ranked[i].second);
+    }
+    return results;
+}
+
+// Splits text into lowercase alphanumeric terms
+QStringList SearchIndex::tokenize(const QString& text) {
+    QStringList terms;
+    QString current;
+    for (const QChar c : text.toCaseFolded()) {
+        if (c.isLetterOrNumber()) {
+            current.append(c);
+        } else if (!current.isEmpty()) {
+            terms.append(current);
+            current.clear();
+        }
+    }
+    if (!current.isEmpty()) terms.append(current);
+    return terms;
+}
+
+// Scores of every item with an indexed term equal to or starting with term. A prefix match scores half its weight
+SearchIndex::Postings SearchIndex::matchesFor(const QString& term) const {
+    Postings matches;
+    for (auto it = postings.lowerBound(term); it != postings.constEnd() && it.key().startsWith(term); ++it) {
+        const bool exact = it.key().size() == term.size();
+        for (auto posting = it.value().constBegin(); posting != it.value().constEnd(); ++posting) {
+            int score = exact ? posting.value() : qMax(1, posting.value() / 2);
+            int& best = matches[posting.key()];
+            best = qMax(best, score);
+        }
+    }
+    return matches;
+}
+
+QVector<SearchIndex::FieldTerm> SearchIndex::termsForItem(const Item* item) {
+    QVector<FieldTerm> terms;
+    addField(terms, item->title, TitleWeight);
+    addField(terms, item->creator, CreatorWeight);
+    switch (item->type) {
+        case ItemType::Fiction:
+            addCode(terms, static_cast<const FictionBook*>(item)->isbn, CodeWeight);
+            break;
+        case ItemType::NonFiction: {
+            auto* nf = static_cast<const NonFictionBook*>(item);
+            addCode(terms, nf->isbn, CodeWeight);
+            addField(terms, nf->deweyClass, DeweyWeight);
+            addCode(terms, nf->deweyClass, DeweyWeight);
+            break;
+        }
+        case ItemType::Movie:
+            addField(terms, static_cast<const Movie*>(item)->genre, GenreWeight);
+            break;
+        case ItemType::VideoGame:
+            addField(terms, static_cast<const VideoGame*>(item)->genre, GenreWeight);
+            break;
+        case ItemType::Magazine:
+            break;
+    }
+    return terms;
+}
+
+void SearchIndex::addField(QVector<FieldTerm>& terms, const QString& text, int weight) {
+    for (const QString& term : tokenize(text)) {
+        terms.append({term, weight});
+    }
+}
+
+// Indexes a code such as an ISBN or Dewey class as one term with its punctuation removed, so "978-0-14" and
+// "978014" match the same item
+void SearchIndex::addCode(QVector<FieldTerm>& terms, const QString& code, int weight) {
+    const QString compact = tokenize(code).join(QString());
+    if (!compact.isEmpty()) terms.append({compact, weight});
+}
@@ -0,0 +1,40 @@
+#ifndef SEARCHINDEX_H
+#define SEARCHINDEX_H
+
+#include "Item.h"
+#include <QMap>
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+// In-memory inverted index over item title, creator, ISBN, genre and Dewey class.
+// Each term maps to the items containing it with a field-weighted score. Every query term must match an item,
+// either exactly or as a prefix of an indexed term; exact matches rank above prefix matches.
+class SearchIndex {
+public:
+    void addItem(const Item* item);
+    void removeItem(const Item* item);
+    void clear();
+
+    QVector<Item*> search(const QString& query, int limit = 50) const;
+
+    static QStringList tokenize(const QString& text);
+
+private:
+    typedef QHash<Item*, int> Postings;
+
+    struct FieldTerm {
+        QString term;
+        int weight;
+    };
+
+    static QVector<FieldTerm> termsForItem(const Item* item);
+    static void addField(QVector<FieldTerm>& terms, const QString& text, int weight);
+    static void addCode(QVector<FieldTerm>& terms, const QString& code, int weight);
+    Postings matchesFor(const QString& term) const;
+
+    QMap<QString, Postings> postings;
+};
+
+#endif // SEARCHINDEX_H
@@ -0,0 +1,39 @@
+#include "StringPool.h"
+
+StringPool::StringPool()
+    : lookups(0),
+      uniqueBytes(0),
+      bytesSaved(0)
+{
+}
+
+StringPool& StringPool::instance() {
+    static StringPool pool;
+    return pool;
+}
+
+// Returns the pooled copy of value, adding it on first sight. Empty strings share Qt's static empty buffer already
+QString StringPool::intern(const QString& value) {
+    if (value.isEmpty()) return QString();
+    ++lookups;
+    const qint64 bytes = value.size() * qint64(sizeof(QChar));
+    auto it = pool.constFind(value);
+    if (it != pool.constEnd()) {
+        bytesSaved += bytes;
+        return *it;
+    }
+    uniqueBytes += bytes;
+    return *pool.insert(value);
+}
+
+StringPool::Stats StringPool::stats() const {
+    return {lookups, pool.size(), uniqueBytes, bytesSaved};
+}
+
+// Drops every pooled string; values still held by items stay valid but are no longer shared with new loads
+void StringPool::clear() {
+    pool.clear();
+    lookups = 0;
+    uniqueBytes = 0;
+    bytesSaved = 0;
+}
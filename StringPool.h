@@ -0,0 +1,43 @@
+#ifndef STRINGPOOL_H
+#define STRINGPOOL_H
+
+#include <QString>
+#include <QSet>
+
+// Interning pool for catalogue attributes that repeat across many items (creators, formats, genres, platforms).
+// intern() returns the pool's copy of a value, so every item holding that value shares one implicitly shared
+// buffer. stats() reports how much character data the sharing saves. Main thread only.
+class StringPool {
+public:
+    struct Stats {
+        int lookups;
+        int uniqueStrings;
+        qint64 uniqueBytes;
+        // Character data that would have been allocated per item without interning
+        qint64 bytesSaved;
+    };
+
+    static StringPool& instance();
+
+    QString intern(const QString& value);
+    Stats stats() const;
+    void clear();
+
+    // Equality for two interned strings: equal values share a buffer, so comparing data pointers is enough.
+    // Strings that did not come from the pool may compare unequal despite equal values
+    static bool sameInterned(const QString& a, const QString& b) {
+        return a.constData() == b.constData();
+    }
+
+private:
+    StringPool();
+    StringPool(const StringPool&) = delete;
+    StringPool& operator=(const StringPool&) = delete;
+
+    QSet<QString> pool;
+    int lookups;
+    qint64 uniqueBytes;
+    qint64 bytesSaved;
+};
+
+#endif // STRINGPOOL_H
@@ -1,59 +1,124 @@
 #include "UserService.h"
 #include "DatabaseManager.h"
 
-// Initializes the service by loading all user data from the database
-UserService::UserService() : currentPatronIndex(0) {
+// Initializes the service by loading every account name from the database; patron loans, holds and
+// fines are loaded on first lookup
+UserService::UserService() : currentPatron(InvalidPatronHandle) {
     loadUsers();
 }
 
 void UserService::loadUsers() {
-    patrons = DatabaseManager::instance().loadAllPatrons();
+    patrons.reset(DatabaseManager::instance().loadPatronNames());
     librarians = DatabaseManager::instance().loadAllLibrarians();
     systemAdmins = DatabaseManager::instance().loadAllSystemAdmins();
+    rebuildDirectory();
 }
 
-// Validates the username and returns the user's role (Patron, Librarian, SystemAdmin, or Invalid)
-Patron* UserService::authenticateUser(const QString& username, QString& role) {
+// Re-reads every account from the database. The current patron is logged out
+void UserService::reloadUsers() {
+    currentPatron = InvalidPatronHandle;
+    loadUsers();
+}
 
-    // 1. Check Librarians FIRST — they MUST NOT be treated as patrons
+void UserService::rebuildDirectory() {
+    directory.clear();
+    directory.reserve(patrons.count() + librarians.size() + systemAdmins.size());
+    for (PatronHandle handle = 0; handle < patrons.count(); ++handle) {
+        DirectoryEntry& entry = directoryEntry(patrons.name(handle));
+        entry.roles |= PatronRole;
+        entry.patron = handle;
+    }
     for (const Librarian& l : librarians) {
-        if (l.name == username) {
-            role = "Librarian";
-            currentPatronIndex = -1;  // librarians are not patrons
-            return nullptr;           // return no Patron*
-        }
+        directoryEntry(l.name).roles |= LibrarianRole;
     }
-
-    // 2. Check System Admins
     for (const SystemAdmin& a : systemAdmins) {
-        if (a.name == username) {
-            role = "Admin";
-            currentPatronIndex = -1;
-            return nullptr;
-        }
+        directoryEntry(a.name).roles |= SystemAdminRole;
     }
+}
 
-    // 3. Check Patrons
-    for (int i = 0; i < patrons.size(); ++i) {
-        if (patrons[i].name == username) {
+// Returns the directory entry for name, creating an empty one if needed
+UserService::DirectoryEntry& UserService::directoryEntry(const QString& name) {
+    auto it = directory.find(name);
+    if (it == directory.end()) it = directory.insert(name, DirectoryEntry{0, InvalidPatronHandle});
+    return it.value();
+}
+
+// Validates the username and returns the user's role (Patron, Librarian, SystemAdmin, or Invalid).
+// Librarians take precedence over admins and admins over patrons; librarians MUST NOT be treated as patrons
+Patron* UserService::authenticateUser(const QString& username, QString& role) {
+    setCurrentPatron(InvalidPatronHandle);
+    auto it = directory.constFind(username);
+    if (it == directory.constEnd()) {
+        role = "Invalid";
+        return nullptr;
+    }
+    const DirectoryEntry& entry = it.value();
+    if (entry.roles & LibrarianRole) {
+        role = "Librarian";
+        return nullptr;
+    }
+    if (entry.roles & SystemAdminRole) {
+        role = "Admin";
+        return nullptr;
+    }
+    if (entry.patron != InvalidPatronHandle) {
+        setCurrentPatron(entry.patron);
+        Patron* patron = getCurrentPatron();
+        if (patron) {
             role = "Patron";
-            currentPatronIndex = i;
-            return &patrons[i];
+            return patron;
         }
+        setCurrentPatron(InvalidPatronHandle);
     }
-
-    // 4. Invalid username
     role = "Invalid";
-    currentPatronIndex = -1;
     return nullptr;
 }
 
-QVector<Patron>& UserService::getPatrons() {
-    return patrons;
+// Bitwise OR of the UserRole flags held by name; 0 for unknown names
+int UserService::rolesFor(const QString& name) const {
+    auto it = directory.constFind(name);
+    return it == directory.constEnd() ? 0 : it.value().roles;
+}
+
+bool UserService::hasRole(const QString& name, UserRole role) const {
+    return (rolesFor(name) & role) != 0;
+}
+
+// Looks up a patron for desk use, loading their state if it is not cached. The pointer stays valid until
+// the patron is evicted from the cache; hold the handle instead for longer-lived references
+Patron* UserService::findPatron(const QString& name) {
+    return patrons.get(findPatronHandle(name));
 }
 
-const QVector<Patron>& UserService::getPatrons() const {
-    return patrons;
+PatronHandle UserService::findPatronHandle(const QString& name) const {
+    auto it = directory.constFind(name);
+    return it == directory.constEnd() ? InvalidPatronHandle : it.value().patron;
+}
+
+// Returns the patron only if their state is already in memory, e.g. to apply a change made directly in the
+// database to the copy the UI is showing
+Patron* UserService::loadedPatron(const QString& name) const {
+    return patrons.peek(findPatronHandle(name));
+}
+
+// Adds a patron account and returns it, or returns nullptr if the name already has one or the account could not be
+// saved. The account is written to the database before it joins the registry, so the registry can reload it after
+// evicting it
+Patron* UserService::addPatron(const Patron& patron) {
+    DirectoryEntry& entry = directoryEntry(patron.name);
+    if (entry.patron != InvalidPatronHandle) return nullptr;
+    if (!DatabaseManager::instance().savePatron(patron)) {
+        // Drop the entry directoryEntry() created unless the name already held another role
+        if (entry.roles == 0) directory.remove(patron.name);
+        return nullptr;
+    }
+    entry.roles |= PatronRole;
+    entry.patron = patrons.add(patron);
+    return patrons.get(entry.patron);
+}
+
+int UserService::patronCount() const {
+    return patrons.count();
 }
 
 QVector<Librarian>& UserService::getLibrarians() {
@@ -72,25 +137,24 @@ const QVector<SystemAdmin>& UserService::getSystemAdmins() const {
     return systemAdmins;
 }
 
-// Returns a pointer to the currently logged in patron for performing library operations
+// Returns a pointer to the currently logged in patron for performing library operations.
+// The current patron is pinned, so the pointer stays valid until they log out
 Patron* UserService::getCurrentPatron() {
-    if (currentPatronIndex < 0 || currentPatronIndex >= patrons.size()) {
-        return nullptr;
-    }
-    return &patrons[currentPatronIndex];
+    return patrons.get(currentPatron);
 }
 
 const Patron* UserService::getCurrentPatron() const {
-    if (currentPatronIndex < 0 || currentPatronIndex >= patrons.size()) {
-        return nullptr;
-    }
-    return &patrons[currentPatronIndex];
+    return patrons.get(currentPatron);
 }
 
-void UserService::setCurrentPatronIndex(int index) {
-    currentPatronIndex = index;
+// Logs in the given patron, or logs out with InvalidPatronHandle
+void UserService::setCurrentPatron(PatronHandle handle) {
+    if (handle == currentPatron) return;
+    if (currentPatron != InvalidPatronHandle) patrons.unpin(currentPatron);
+    currentPatron = handle;
+    if (currentPatron != InvalidPatronHandle) patrons.pin(currentPatron);
 }
 
-int UserService::getCurrentPatronIndex() const {
-    return currentPatronIndex;
+PatronHandle UserService::getCurrentPatronHandle() const {
+    return currentPatron;
 }
@@ -2,17 +2,33 @@
 #define USERSERVICE_H
 
 #include "User.h"
+#include "PatronRegistry.h"
 #include <QVector>
 #include <QString>
+#include <QHash>
+
+// Role flags; one name may hold several roles, e.g. a librarian who also borrows as a patron
+enum UserRole {
+    PatronRole = 0x1,
+    LibrarianRole = 0x2,
+    SystemAdminRole = 0x4
+};
 
 class UserService {
 public:
     UserService();
 
     Patron* authenticateUser(const QString& username, QString& role);
+    int rolesFor(const QString& name) const;
+    bool hasRole(const QString& name, UserRole role) const;
+    Patron* findPatron(const QString& name);
+    PatronHandle findPatronHandle(const QString& name) const;
+    Patron* loadedPatron(const QString& name) const;
+
+    Patron* addPatron(const Patron& patron);
+    void reloadUsers();
 
-    QVector<Patron>& getPatrons();
-    const QVector<Patron>& getPatrons() const;
+    int patronCount() const;
     QVector<Librarian>& getLibrarians();
     const QVector<Librarian>& getLibrarians() const;
     QVector<SystemAdmin>& getSystemAdmins();
@@ -20,16 +36,28 @@ public:
 
     Patron* getCurrentPatron();
     const Patron* getCurrentPatron() const;
-    void setCurrentPatronIndex(int index);
-    int getCurrentPatronIndex() const;
+    void setCurrentPatron(PatronHandle handle);
+    PatronHandle getCurrentPatronHandle() const;
 
 private:
-    QVector<Patron> patrons;
+    struct DirectoryEntry {
+        int roles;
+        // Handle into patrons, or InvalidPatronHandle if the name has no patron account
+        PatronHandle patron;
+    };
+
+    // Loads patron state on demand; mutable so const lookups can fill the cache
+    mutable PatronRegistry patrons;
     QVector<Librarian> librarians;
     QVector<SystemAdmin> systemAdmins;
-    int currentPatronIndex;
+    // Pinned in patrons while logged in
+    PatronHandle currentPatron;
+    // Every account name with its roles. Names must not change once added; rebuilt by loadUsers()
+    QHash<QString, DirectoryEntry> directory;
 
     void loadUsers();
+    void rebuildDirectory();
+    DirectoryEntry& directoryEntry(const QString& name);
 };
 
 #endif // USERSERVICE_H
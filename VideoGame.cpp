@@ -8,10 +8,14 @@ VideoGame::VideoGame(const QString& title,
                      const QString& platform,
                      const QString& genre,
                      int rating)
-    : Item(title, studio, year, format, condition), platform(platform), genre(genre), rating(rating)
+    : Item(ItemType::VideoGame, title, studio, year, format, condition), platform(platform), genre(genre), rating(rating)
 {
 }
 
 QString VideoGame::typeName() const {
     return "Video Game";
 }
+
+Item* VideoGame::clone() const {
+    return new VideoGame(*this);
+}
@@ -19,6 +19,7 @@ public:
               int rating);
 
     QString typeName() const override;
+    Item* clone() const override;
 };
 
 #endif // VIDEOGAME_H
@@ -5,6 +5,8 @@
 #include "UserService.h"
 #include "LoanService.h"
 #include "HoldService.h"
+#include "FinesEngine.h"
+#include <QTimer>
 
 int main(int argc, char *argv[])
 {
@@ -13,14 +15,24 @@ int main(int argc, char *argv[])
     if (!DatabaseManager::instance().initialize()) {
         return -1;
     }
+    DatabaseManager::instance().startWriteBehind();
 
     LibraryService libraryService;
     UserService userService;
-    LoanService loanService(&libraryService);
-    HoldService holdService(&libraryService, &loanService);
+    LoanService loanService(&libraryService, &userService);
+    HoldService holdService(&libraryService, &loanService, &userService);
+    FinesEngine finesEngine(&userService);
 
-    MainWindow w(&libraryService, &userService, &loanService, &holdService);
+    // The fines pass is idempotent per day: run it at startup, then check hourly for the date rolling over
+    finesEngine.runNightlyPass();
+    QTimer finesTimer;
+    QObject::connect(&finesTimer, &QTimer::timeout, [&finesEngine]() { finesEngine.runNightlyPass(); });
+    finesTimer.start(60 * 60 * 1000);
+
+    MainWindow w(&libraryService, &userService, &loanService, &holdService, &finesEngine);
     w.show();
 
-    return a.exec();
+    int result = a.exec();
+    DatabaseManager::instance().close();
+    return result;
 }
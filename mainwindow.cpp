@@ -1,6 +1,7 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
 #include "ReturnOnBehalfDialog.h"
+#include "DatabaseManager.h"
 #include <QMessageBox>
 #include <QLabel>
 #include <QPushButton>
@@ -9,6 +10,7 @@
 #include <QStackedWidget>
 #include <QHeaderView>
 #include <QAction>
+#include <QTimer>
 #include <algorithm>
 
 // Helper function to get child widgets by name
@@ -40,22 +42,30 @@ MainWindow::MainWindow(LibraryService* libService,
                        UserService* userService,
                        LoanService* loanService,
                        HoldService* holdService,
+                       FinesEngine* finesEngine,
                        QWidget *parent)
     : QMainWindow(parent),
       ui(new Ui::MainWindow),
       libraryService(libService),
       userService(userService),
       loanService(loanService),
-      holdService(holdService)
+      holdService(holdService),
+      finesEngine(finesEngine)
 {
     Q_ASSERT(libraryService != nullptr);
     Q_ASSERT(userService != nullptr);
     Q_ASSERT(loanService != nullptr);
     Q_ASSERT(holdService != nullptr);
+    Q_ASSERT(finesEngine != nullptr);
 
     ui->setupUi(this);
     setupConnections();
     showLoginScreen();
+
+    // Units of work commit in the background; pick up their outcomes without blocking the UI
+    QTimer* settleTimer = new QTimer(this);
+    connect(settleTimer, &QTimer::timeout, this, &MainWindow::settleWrites);
+    settleTimer->start(200);
 }
 MainWindow::~MainWindow() {
     delete ui;
@@ -119,7 +129,9 @@ void MainWindow::setupLoginHandling() {
             const QString username = userEdit ? userEdit->text().trimmed() : QString();
 
             QString role;
-            userService->authenticateUser(username, role);
+            Patron* patron = userService->authenticateUser(username, role);
+            // Bring the patron's fines up to date before anything shows them
+            if (patron) finesEngine->accrueForPatron(patron);
 
             auto* roleLbl = get<QLabel>(this, "userRoleLabel");
 
@@ -224,8 +236,7 @@ void MainWindow::on_backFromAccountButton_clicked() {
 // Borrow button slot
 void MainWindow::on_borrowSelectedButton_clicked() {
     if (QTableWidget* t = currentTable()) {
-        int row = t->currentRow();
-        if (row >= 0) borrowFromRow(t, row);
+        borrowSelected(t);
     }
 }
 
@@ -240,10 +251,7 @@ void MainWindow::on_unborrowSelectedButton_clicked() {
     }
 
     if (!t) return;
-    int row = t->currentRow();
-    if (row >= 0) {
-        returnFromRow(t, row);
-    }
+    returnSelected(t);
 }
 
 // Unborrow action slot
@@ -257,10 +265,7 @@ void MainWindow::unborrowActionTriggered() {
     }
 
     if (!t) return;
-    int row = t->currentRow();
-    if (row >= 0) {
-        returnFromRow(t, row);
-    }
+    returnSelected(t);
 }
 
 // Place hold button slot
@@ -274,6 +279,7 @@ void MainWindow::on_placeHoldButton_clicked() {
         ActionResult result = holdService->placeHold(patron, id);
 
         populateAccountStatus();
+        reportFailedWrites();
         statusBar()->showMessage(result.msg, 3000);
     }
 }
@@ -349,43 +355,82 @@ QUuid MainWindow::idForRow(QTableWidget* table, int row) const {
     return QUuid(idStr);
 }
 
-// Initiates a borrow action for the item at the specified table row
-void MainWindow::borrowFromRow(QTableWidget* table, int row) {
+// Gets the item UUIDs of every selected row, in row order, falling back to the current row
+QVector<QUuid> MainWindow::selectedIds(QTableWidget* table) const {
+    QVector<QUuid> ids;
+    if (!table) return ids;
+    QVector<int> rows;
+    for (QTableWidgetItem* it : table->selectedItems()) {
+        if (!rows.contains(it->row())) rows.append(it->row());
+    }
+    if (rows.isEmpty() && table->currentRow() >= 0) rows.append(table->currentRow());
+    std::sort(rows.begin(), rows.end());
+    for (int row : rows) {
+        const QUuid id = idForRow(table, row);
+        if (!id.isNull()) ids.append(id);
+    }
+    return ids;
+}
+
+// Builds a status bar message for a batch: the item's own message for a single item, otherwise a count of the
+// successes plus the first failure
+QString MainWindow::summarizeResults(const QVector<LoanService::ItemResult>& results, const QString& verb) const {
+    if (results.size() == 1) return results.first().result.msg;
+    int succeeded = 0;
+    QString firstFailure;
+    for (const LoanService::ItemResult& r : results) {
+        if (r.result.ok) ++succeeded;
+        else if (firstFailure.isEmpty()) firstFailure = r.result.msg;
+    }
+    QString msg = QString("%1 %2 of %3 items.").arg(verb).arg(succeeded).arg(results.size());
+    if (!firstFailure.isEmpty()) msg += " " + firstFailure;
+    return msg;
+}
+
+// Borrows every selected item in one batch, then refreshes the tables once
+void MainWindow::borrowSelected(QTableWidget* table) {
     if (!table) return;
 
-    const QUuid id = idForRow(table, row);
-    if (id.isNull()) return;
+    const QVector<QUuid> ids = selectedIds(table);
+    if (ids.isEmpty()) return;
+    const int row = table->currentRow();
 
     Patron* patron = userService->getCurrentPatron();
-    ActionResult result = loanService->borrowItem(patron, id);
+    const QVector<LoanService::ItemResult> results = loanService->borrowItems(patron, ids);
 
     refreshAllTables();
     populateAccountStatus();
 
-    if (!result.msg.isEmpty()) statusBar()->showMessage(result.msg, 3000);
+    const QString msg = summarizeResults(results, "Borrowed");
+    if (!msg.isEmpty()) statusBar()->showMessage(msg, 3000);
     if (row >= 0 && row < table->rowCount()) table->setCurrentCell(row, 0);
 }
 
-// Processes a return action for the item at the specified table row
-void MainWindow::returnFromRow(QTableWidget* table, int row) {
+// Returns every selected item in one batch, then refreshes the tables once
+void MainWindow::returnSelected(QTableWidget* table) {
     if (!table) return;
 
-    const QUuid id = idForRow(table, row);
-    if (id.isNull()) return;
+    const QVector<QUuid> ids = selectedIds(table);
+    if (ids.isEmpty()) return;
+    const int row = table->currentRow();
 
     Patron* patron = userService->getCurrentPatron();
-    ActionResult result = loanService->returnItem(patron, id);
+    // Charge overdue days up to today while the loans still exist
+    finesEngine->accrueForPatron(patron);
+    const QVector<LoanService::ItemResult> results = loanService->returnItems(patron, ids);
 
     refreshAllTables();
     populateAccountStatus();
 
-    if (!result.msg.isEmpty()) statusBar()->showMessage(result.msg, 3000);
+    const QString msg = summarizeResults(results, "Returned");
+    if (!msg.isEmpty()) statusBar()->showMessage(msg, 3000);
     if (row >= 0 && row < table->rowCount())
         table->setCurrentCell(std::min(row, table->rowCount() - 1), 0);
 }
 
 // Navigates to the account status page showing the patrons loans, holds, and fines
 void MainWindow::showAccountStatusPage() {
+    finesEngine->accrueForPatron(userService->getCurrentPatron());
     populateAccountStatus();
     auto* stacked = get<QStackedWidget>(this, "stackedWidget");
     QWidget* accPage = get<QWidget>(this, "accountPage");
@@ -404,13 +449,7 @@ void MainWindow::populateAccountStatus() {
         lbl->setText(p->name);
 
     // Role text
-    QString roleText = "Patron";
-    for (const Librarian& l : userService->getLibrarians()) {
-        if (l.name == p->name) {
-            roleText = "Librarian / Patron";
-            break;
-        }
-    }
+    QString roleText = userService->hasRole(p->name, LibrarianRole) ? "Librarian / Patron" : "Patron";
 
     if (auto* role = get<QLabel>(this, "accountRoleLabel"))
         role->setText(roleText);
@@ -495,13 +534,35 @@ QString MainWindow::statusToString(ItemStatus s) const {
     return statToString(s);
 }
 
-// Reloads all category tables to reflect the current state of the catalogue
+// Picks up catalogue changes made by other processes, then reloads all category tables from the catalogue
 void MainWindow::refreshAllTables() {
+    libraryService->reloadCatalogue();
     populateFictionTable();
     populateNonFictionTable();
     populateMagazineTable();
     populateMovieTable();
     populateVideoGameTable();
+    reportFailedWrites();
+}
+
+// Runs the rollbacks of units of work the write-behind worker could not commit, then shows the restored state
+void MainWindow::settleWrites() {
+    const int rolledBack = DatabaseManager::instance().dispatchWriteCompletions();
+    if (rolledBack == 0) return;
+    refreshAllTables();
+    QMessageBox::warning(this, "Save failed",
+                         QString("%1 change(s) could not be saved to the database and were undone.").arg(rolledBack));
+}
+
+// Warns the user about background writes that never reached the database, so memory and disk disagreeing is not
+// silent
+void MainWindow::reportFailedWrites() {
+    const int failed = DatabaseManager::instance().takeFailedWriteCount();
+    if (failed > 0) {
+        QMessageBox::warning(this, "Save failed",
+                             QString("%1 change(s) could not be saved to the database. "
+                                     "Restart the application to reload the current state.").arg(failed));
+    }
 }
 
 // Populate Fiction Table
@@ -518,27 +579,25 @@ void MainWindow::populateFictionTable() {
         QString patronName = currentP ? currentP->name : QString();
 
         int row = 0;
-        QVector<Item*> items = libraryService->getAllItems();
-        for (Item* item : items) {
-            if (auto* fb = dynamic_cast<FictionBook*>(item)) {
-                t->insertRow(row);
-
-                auto* titleItem = new QTableWidgetItem(fb->title);
-                titleItem->setData(Qt::UserRole, fb->itemId.toString());
-                t->setItem(row, 0, titleItem);
-                t->setItem(row, 1, new QTableWidgetItem(fb->creator));
-                t->setItem(row, 2, new QTableWidgetItem(QString::number(fb->publicationYear)));
-                t->setItem(row, 3, new QTableWidgetItem(fb->format));
-                t->setItem(row, 4, new QTableWidgetItem(condToString(fb->condition)));
-                t->setItem(row, 5, new QTableWidgetItem(fb->isbn));
-
-                // USE PATRON-SPECIFIC STATUS
-                ItemStatus displayStatus = fb->getStatusForPatron(patronName);
-                t->setItem(row, 6, new QTableWidgetItem(statToString(displayStatus)));
-
-                ++row;
-            }
-        }
+        libraryService->forEachItemOfType(ItemType::Fiction, [&](Item* item) {
+            auto* fb = static_cast<FictionBook*>(item);
+            t->insertRow(row);
+
+            auto* titleItem = new QTableWidgetItem(fb->title);
+            titleItem->setData(Qt::UserRole, fb->itemId.toString());
+            t->setItem(row, 0, titleItem);
+            t->setItem(row, 1, new QTableWidgetItem(fb->creator));
+            t->setItem(row, 2, new QTableWidgetItem(QString::number(fb->publicationYear)));
+            t->setItem(row, 3, new QTableWidgetItem(fb->format));
+            t->setItem(row, 4, new QTableWidgetItem(condToString(fb->condition)));
+            t->setItem(row, 5, new QTableWidgetItem(fb->isbn));
+
+            // USE PATRON-SPECIFIC STATUS
+            ItemStatus displayStatus = fb->getStatusForPatron(patronName);
+            t->setItem(row, 6, new QTableWidgetItem(statToString(displayStatus)));
+
+            ++row;
+        });
         t->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
     }
 }
@@ -557,28 +616,26 @@ void MainWindow::populateNonFictionTable() {
         QString patronName = currentP ? currentP->name : QString();
 
         int row = 0;
-        QVector<Item*> items = libraryService->getAllItems();
-        for (Item* item : items) {
-            if (auto* nf = dynamic_cast<NonFictionBook*>(item)) {
-                t->insertRow(row);
-
-                auto* titleItem = new QTableWidgetItem(nf->title);
-                titleItem->setData(Qt::UserRole, nf->itemId.toString());
-                t->setItem(row, 0, titleItem);
-                t->setItem(row, 1, new QTableWidgetItem(nf->creator));
-                t->setItem(row, 2, new QTableWidgetItem(QString::number(nf->publicationYear)));
-                t->setItem(row, 3, new QTableWidgetItem(nf->format));
-                t->setItem(row, 4, new QTableWidgetItem(condToString(nf->condition)));
-                t->setItem(row, 5, new QTableWidgetItem(nf->isbn));
-                t->setItem(row, 6, new QTableWidgetItem(nf->deweyClass));
-
-                // USE PATRON-SPECIFIC STATUS
-                ItemStatus displayStatus = nf->getStatusForPatron(patronName);
-                t->setItem(row, 7, new QTableWidgetItem(statToString(displayStatus)));
-
-                ++row;
-            }
-        }
+        libraryService->forEachItemOfType(ItemType::NonFiction, [&](Item* item) {
+            auto* nf = static_cast<NonFictionBook*>(item);
+            t->insertRow(row);
+
+            auto* titleItem = new QTableWidgetItem(nf->title);
+            titleItem->setData(Qt::UserRole, nf->itemId.toString());
+            t->setItem(row, 0, titleItem);
+            t->setItem(row, 1, new QTableWidgetItem(nf->creator));
+            t->setItem(row, 2, new QTableWidgetItem(QString::number(nf->publicationYear)));
+            t->setItem(row, 3, new QTableWidgetItem(nf->format));
+            t->setItem(row, 4, new QTableWidgetItem(condToString(nf->condition)));
+            t->setItem(row, 5, new QTableWidgetItem(nf->isbn));
+            t->setItem(row, 6, new QTableWidgetItem(nf->deweyClass));
+
+            // USE PATRON-SPECIFIC STATUS
+            ItemStatus displayStatus = nf->getStatusForPatron(patronName);
+            t->setItem(row, 7, new QTableWidgetItem(statToString(displayStatus)));
+
+            ++row;
+        });
         t->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
     }
 }
@@ -597,28 +654,26 @@ void MainWindow::populateMagazineTable() {
         QString patronName = currentP ? currentP->name : QString();
 
         int row = 0;
-        QVector<Item*> items = libraryService->getAllItems();
-        for (Item* item : items) {
-            if (auto* mag = dynamic_cast<Magazine*>(item)) {
-                t->insertRow(row);
-
-                auto* titleItem = new QTableWidgetItem(mag->title);
-                titleItem->setData(Qt::UserRole, mag->itemId.toString());
-                t->setItem(row, 0, titleItem);
-                t->setItem(row, 1, new QTableWidgetItem(mag->creator));
-                t->setItem(row, 2, new QTableWidgetItem(QString::number(mag->publicationYear)));
-                t->setItem(row, 3, new QTableWidgetItem(mag->format));
-                t->setItem(row, 4, new QTableWidgetItem(condToString(mag->condition)));
-                t->setItem(row, 5, new QTableWidgetItem(QString::number(mag->issueNumber)));
-                t->setItem(row, 6, new QTableWidgetItem(mag->publicationDate.toString()));
-
-                // USE PATRON-SPECIFIC STATUS
-                ItemStatus displayStatus = mag->getStatusForPatron(patronName);
-                t->setItem(row, 7, new QTableWidgetItem(statToString(displayStatus)));
-
-                ++row;
-            }
-        }
+        libraryService->forEachItemOfType(ItemType::Magazine, [&](Item* item) {
+            auto* mag = static_cast<Magazine*>(item);
+            t->insertRow(row);
+
+            auto* titleItem = new QTableWidgetItem(mag->title);
+            titleItem->setData(Qt::UserRole, mag->itemId.toString());
+            t->setItem(row, 0, titleItem);
+            t->setItem(row, 1, new QTableWidgetItem(mag->creator));
+            t->setItem(row, 2, new QTableWidgetItem(QString::number(mag->publicationYear)));
+            t->setItem(row, 3, new QTableWidgetItem(mag->format));
+            t->setItem(row, 4, new QTableWidgetItem(condToString(mag->condition)));
+            t->setItem(row, 5, new QTableWidgetItem(QString::number(mag->issueNumber)));
+            t->setItem(row, 6, new QTableWidgetItem(mag->publicationDate.toString()));
+
+            // USE PATRON-SPECIFIC STATUS
+            ItemStatus displayStatus = mag->getStatusForPatron(patronName);
+            t->setItem(row, 7, new QTableWidgetItem(statToString(displayStatus)));
+
+            ++row;
+        });
         t->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
     }
 }
@@ -637,28 +692,26 @@ void MainWindow::populateMovieTable() {
         QString patronName = currentP ? currentP->name : QString();
 
         int row = 0;
-        QVector<Item*> items = libraryService->getAllItems();
-        for (Item* item : items) {
-            if (auto* mov = dynamic_cast<Movie*>(item)) {
-                t->insertRow(row);
-
-                auto* titleItem = new QTableWidgetItem(mov->title);
-                titleItem->setData(Qt::UserRole, mov->itemId.toString());
-                t->setItem(row, 0, titleItem);
-                t->setItem(row, 1, new QTableWidgetItem(mov->creator));
-                t->setItem(row, 2, new QTableWidgetItem(QString::number(mov->publicationYear)));
-                t->setItem(row, 3, new QTableWidgetItem(mov->format));
-                t->setItem(row, 4, new QTableWidgetItem(condToString(mov->condition)));
-                t->setItem(row, 5, new QTableWidgetItem(mov->genre));
-                t->setItem(row, 6, new QTableWidgetItem(QString::number(mov->rating)));
-
-                // USE PATRON-SPECIFIC STATUS
-                ItemStatus displayStatus = mov->getStatusForPatron(patronName);
-                t->setItem(row, 7, new QTableWidgetItem(statToString(displayStatus)));
-
-                ++row;
-            }
-        }
+        libraryService->forEachItemOfType(ItemType::Movie, [&](Item* item) {
+            auto* mov = static_cast<Movie*>(item);
+            t->insertRow(row);
+
+            auto* titleItem = new QTableWidgetItem(mov->title);
+            titleItem->setData(Qt::UserRole, mov->itemId.toString());
+            t->setItem(row, 0, titleItem);
+            t->setItem(row, 1, new QTableWidgetItem(mov->creator));
+            t->setItem(row, 2, new QTableWidgetItem(QString::number(mov->publicationYear)));
+            t->setItem(row, 3, new QTableWidgetItem(mov->format));
+            t->setItem(row, 4, new QTableWidgetItem(condToString(mov->condition)));
+            t->setItem(row, 5, new QTableWidgetItem(mov->genre));
+            t->setItem(row, 6, new QTableWidgetItem(QString::number(mov->rating)));
+
+            // USE PATRON-SPECIFIC STATUS
+            ItemStatus displayStatus = mov->getStatusForPatron(patronName);
+            t->setItem(row, 7, new QTableWidgetItem(statToString(displayStatus)));
+
+            ++row;
+        });
         t->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
     }
 }
@@ -677,29 +730,27 @@ void MainWindow::populateVideoGameTable() {
         QString patronName = currentP ? currentP->name : QString();
 
         int row = 0;
-        QVector<Item*> items = libraryService->getAllItems();
-        for (Item* item : items) {
-            if (auto* vg = dynamic_cast<VideoGame*>(item)) {
-                t->insertRow(row);
-
-                auto* titleItem = new QTableWidgetItem(vg->title);
-                titleItem->setData(Qt::UserRole, vg->itemId.toString());
-                t->setItem(row, 0, titleItem);
-                t->setItem(row, 1, new QTableWidgetItem(vg->creator));
-                t->setItem(row, 2, new QTableWidgetItem(QString::number(vg->publicationYear)));
-                t->setItem(row, 3, new QTableWidgetItem(vg->format));
-                t->setItem(row, 4, new QTableWidgetItem(condToString(vg->condition)));
-                t->setItem(row, 5, new QTableWidgetItem(vg->platform));
-                t->setItem(row, 6, new QTableWidgetItem(vg->genre));
-                t->setItem(row, 7, new QTableWidgetItem(QString::number(vg->rating)));
-
-                // USE PATRON-SPECIFIC STATUS
-                ItemStatus displayStatus = vg->getStatusForPatron(patronName);
-                t->setItem(row, 8, new QTableWidgetItem(statToString(displayStatus)));
-
-                ++row;
-            }
-        }
+        libraryService->forEachItemOfType(ItemType::VideoGame, [&](Item* item) {
+            auto* vg = static_cast<VideoGame*>(item);
+            t->insertRow(row);
+
+            auto* titleItem = new QTableWidgetItem(vg->title);
+            titleItem->setData(Qt::UserRole, vg->itemId.toString());
+            t->setItem(row, 0, titleItem);
+            t->setItem(row, 1, new QTableWidgetItem(vg->creator));
+            t->setItem(row, 2, new QTableWidgetItem(QString::number(vg->publicationYear)));
+            t->setItem(row, 3, new QTableWidgetItem(vg->format));
+            t->setItem(row, 4, new QTableWidgetItem(condToString(vg->condition)));
+            t->setItem(row, 5, new QTableWidgetItem(vg->platform));
+            t->setItem(row, 6, new QTableWidgetItem(vg->genre));
+            t->setItem(row, 7, new QTableWidgetItem(QString::number(vg->rating)));
+
+            // USE PATRON-SPECIFIC STATUS
+            ItemStatus displayStatus = vg->getStatusForPatron(patronName);
+            t->setItem(row, 8, new QTableWidgetItem(statToString(displayStatus)));
+
+            ++row;
+        });
         t->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
     }
 }
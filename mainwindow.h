@@ -9,6 +9,7 @@
 #include "UserService.h"
 #include "LoanService.h"
 #include "HoldService.h"
+#include "FinesEngine.h"
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
@@ -22,6 +23,7 @@ public:
                        UserService* userService,
                        LoanService* loanService,
                        HoldService* holdService,
+                       FinesEngine* finesEngine,
                        QWidget *parent = nullptr);
     ~MainWindow();
 
@@ -48,6 +50,9 @@ private slots:
     // Logout
     void on_logoutButton_clicked();
 
+    // Write-behind outcomes
+    void settleWrites();
+
 private:
     Ui::MainWindow *ui;
 
@@ -56,16 +61,19 @@ private:
     UserService* userService;
     LoanService* loanService;
     HoldService* holdService;
+    FinesEngine* finesEngine;
 
     // UI helpers
     QTableWidget* currentTable() const;
     QUuid idForRow(QTableWidget* table, int row) const;
+    QVector<QUuid> selectedIds(QTableWidget* table) const;
+    QString summarizeResults(const QVector<LoanService::ItemResult>& results, const QString& verb) const;
 
     // Borrowing helper
-    void borrowFromRow(QTableWidget* table, int row);
+    void borrowSelected(QTableWidget* table);
 
     // Return helper
-    void returnFromRow(QTableWidget* table, int row);
+    void returnSelected(QTableWidget* table);
 
     // Table population
     void setupTableHeaders(QTableWidget* table);
@@ -75,6 +83,7 @@ private:
     void populateMovieTable();
     void populateVideoGameTable();
     void refreshAllTables();
+    void reportFailedWrites();
 
     // Account page
     void showAccountStatusPage();